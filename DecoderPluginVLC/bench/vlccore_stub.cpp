@@ -0,0 +1,575 @@
+/*****************************************************************************
+ * vlccore_stub.cpp: minimal libvlccore replacement for the benchmark driver
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Only the core functions referenced by the decoder and the packetizer are
+ * implemented here, so that they can run without libvlccore, a vout or an
+ * input thread. Function names are parenthesized to bypass the VLC_OBJECT()
+ * wrapper macros of the headers.
+ *****************************************************************************/
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vlc_common.h>
+#include <vlc_block.h>
+#include <vlc_cpu.h>
+#include <vlc_es.h>
+#include <vlc_picture.h>
+#include <vlc_variables.h>
+
+#include "vlccore_stub.h"
+
+/*****************************************************************************
+ * Messages
+ *****************************************************************************/
+static int g_verbosity = VLC_MSG_WARN;
+
+void BenchStub::SetVerbosity(int verbosity)
+{
+  g_verbosity = verbosity;
+}
+
+void vlc_Log(vlc_object_t* obj, int prio, const char* module,
+  const char* file, unsigned line, const char* func, const char* format, ...)
+{
+  VLC_UNUSED(obj); VLC_UNUSED(file); VLC_UNUSED(line); VLC_UNUSED(func);
+  static const char* const ppsz_prio[] = { "info", "error", "warning", "debug" };
+  if (prio > g_verbosity && prio != VLC_MSG_ERR)
+    return;
+  va_list ap;
+  va_start(ap, format);
+  fprintf(stderr, "[%s] %s: ", module, ppsz_prio[prio & 3]);
+  vfprintf(stderr, format, ap);
+  fputc('\n', stderr);
+  va_end(ap);
+}
+
+/*****************************************************************************
+ * Clock and cpu
+ *****************************************************************************/
+mtime_t mdate(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (INT64_C(1000000) * ts.tv_sec) + (ts.tv_nsec / 1000);
+}
+
+unsigned vlc_CPU(void)
+{
+  unsigned flags = 0;
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("sse2"))
+    flags |= VLC_CPU_SSE2;
+  if (__builtin_cpu_supports("ssse3"))
+    flags |= VLC_CPU_SSSE3;
+  if (__builtin_cpu_supports("sse4.1"))
+    flags |= VLC_CPU_SSE4_1;
+  if (__builtin_cpu_supports("avx"))
+    flags |= VLC_CPU_AVX;
+  if (__builtin_cpu_supports("avx2"))
+    flags |= VLC_CPU_AVX2;
+#endif
+  return flags;
+}
+
+void date_Init(date_t* p_date, uint32_t i_divider_n, uint32_t i_divider_d)
+{
+  p_date->date = 0;
+  p_date->i_divider_num = i_divider_n;
+  p_date->i_divider_den = i_divider_d;
+  p_date->i_remainder = 0;
+}
+
+void date_Change(date_t* p_date, uint32_t i_divider_n, uint32_t i_divider_d)
+{
+  p_date->i_remainder = p_date->i_remainder * i_divider_n / p_date->i_divider_num;
+  p_date->i_divider_num = i_divider_n;
+  p_date->i_divider_den = i_divider_d;
+}
+
+void date_Set(date_t* p_date, mtime_t i_new_date)
+{
+  p_date->date = i_new_date;
+  p_date->i_remainder = 0;
+}
+
+mtime_t date_Get(const date_t* p_date)
+{
+  return p_date->date;
+}
+
+mtime_t date_Increment(date_t* p_date, uint32_t i_nb_samples)
+{
+  const mtime_t i_dividend = (mtime_t)i_nb_samples * CLOCK_FREQ * p_date->i_divider_den;
+  p_date->date += i_dividend / p_date->i_divider_num;
+  p_date->i_remainder += (uint32_t)(i_dividend % p_date->i_divider_num);
+  if (p_date->i_remainder >= p_date->i_divider_num)
+  {
+    p_date->date += 1;
+    p_date->i_remainder -= p_date->i_divider_num;
+  }
+  return p_date->date;
+}
+
+mtime_t date_Decrement(date_t* p_date, uint32_t i_nb_samples)
+{
+  const mtime_t i_dividend = (mtime_t)i_nb_samples * CLOCK_FREQ * p_date->i_divider_den;
+  p_date->date -= i_dividend / p_date->i_divider_num;
+  const uint32_t i_rem_adjust = (uint32_t)(i_dividend % p_date->i_divider_num);
+  if (p_date->i_remainder < i_rem_adjust)
+  {
+    p_date->date -= 1;
+    p_date->i_remainder += p_date->i_divider_num;
+  }
+  p_date->i_remainder -= i_rem_adjust;
+  return p_date->date;
+}
+
+/*****************************************************************************
+ * Threads (POSIX only)
+ *****************************************************************************/
+void vlc_mutex_init(vlc_mutex_t* p_mutex)
+{
+  pthread_mutex_init(p_mutex, NULL);
+}
+
+void vlc_mutex_destroy(vlc_mutex_t* p_mutex)
+{
+  pthread_mutex_destroy(p_mutex);
+}
+
+void vlc_mutex_lock(vlc_mutex_t* p_mutex)
+{
+  pthread_mutex_lock(p_mutex);
+}
+
+void vlc_mutex_unlock(vlc_mutex_t* p_mutex)
+{
+  pthread_mutex_unlock(p_mutex);
+}
+
+void vlc_sem_init(vlc_sem_t* sem, unsigned value)
+{
+  sem_init(sem, 0, value);
+}
+
+void vlc_sem_destroy(vlc_sem_t* sem)
+{
+  sem_destroy(sem);
+}
+
+int vlc_sem_post(vlc_sem_t* sem)
+{
+  return sem_post(sem) ? errno : 0;
+}
+
+void vlc_sem_wait(vlc_sem_t* sem)
+{
+  while (sem_wait(sem) && errno == EINTR);
+}
+
+int vlc_clone(vlc_thread_t* th, void* (*entry)(void*), void* data, int priority)
+{
+  VLC_UNUSED(priority);
+  return pthread_create(th, NULL, entry, data);
+}
+
+void vlc_join(vlc_thread_t th, void** result)
+{
+  pthread_join(th, result);
+}
+
+/*****************************************************************************
+ * Variables: a single name space, initialized from the module configuration
+ *****************************************************************************/
+namespace
+{
+  struct stub_var
+  {
+    int type;
+    int64_t i_int;
+    double f_float;
+    std::string psz_string;
+  };
+  std::mutex g_varLock;
+  std::map<std::string, stub_var> g_config;
+  std::map<std::string, stub_var> g_vars;
+
+  void setFromString(stub_var& var, const char* psz_value)
+  {
+    var.i_int = strtoll(psz_value, NULL, 0);
+    var.f_float = strtod(psz_value, NULL);
+    var.psz_string = psz_value;
+    if (!strcmp(psz_value, "true") || !strcmp(psz_value, "yes"))
+      var.i_int = 1;
+  }
+}
+
+void BenchStub::ConfigDefault(const char* psz_name, int type, int64_t i_value, double f_value, const char* psz_value)
+{
+  std::lock_guard<std::mutex> lock(g_varLock);
+  if (g_config.count(psz_name))
+    return; // already set from the command line
+  stub_var& var = g_config[psz_name];
+  var.type = type;
+  var.i_int = i_value;
+  var.f_float = f_value;
+  var.psz_string = psz_value ? psz_value : "";
+}
+
+void BenchStub::ConfigSet(const char* psz_name, const char* psz_value)
+{
+  std::lock_guard<std::mutex> lock(g_varLock);
+  setFromString(g_config[psz_name], psz_value);
+}
+
+int (var_Create)(vlc_object_t* p_this, const char* psz_name, int i_type)
+{
+  VLC_UNUSED(p_this);
+  std::lock_guard<std::mutex> lock(g_varLock);
+  stub_var& var = g_vars[psz_name];
+  var.type = i_type & VLC_VAR_CLASS;
+  if ((i_type & VLC_VAR_DOINHERIT) && g_config.count(psz_name))
+  {
+    const stub_var& cfg = g_config[psz_name];
+    var.i_int = cfg.i_int;
+    var.f_float = cfg.f_float;
+    var.psz_string = cfg.psz_string;
+  }
+  return VLC_SUCCESS;
+}
+
+void (var_Destroy)(vlc_object_t* p_this, const char* psz_name)
+{
+  VLC_UNUSED(p_this);
+  std::lock_guard<std::mutex> lock(g_varLock);
+  g_vars.erase(psz_name);
+}
+
+int (var_GetChecked)(vlc_object_t* p_this, const char* psz_name, int i_type, vlc_value_t* p_val)
+{
+  VLC_UNUSED(p_this);
+  std::lock_guard<std::mutex> lock(g_varLock);
+  auto it = g_vars.find(psz_name);
+  if (it == g_vars.end())
+    return VLC_ENOVAR;
+  switch (i_type & VLC_VAR_CLASS)
+  {
+  case VLC_VAR_BOOL:
+    p_val->b_bool = it->second.i_int != 0;
+    break;
+  case VLC_VAR_INTEGER:
+    p_val->i_int = it->second.i_int;
+    break;
+  case VLC_VAR_FLOAT:
+    p_val->f_float = (float)it->second.f_float;
+    break;
+  case VLC_VAR_STRING:
+    p_val->psz_string = strdup(it->second.psz_string.c_str());
+    break;
+  default:
+    return VLC_EGENERIC;
+  }
+  return VLC_SUCCESS;
+}
+
+int (var_SetChecked)(vlc_object_t* p_this, const char* psz_name, int i_type, vlc_value_t val)
+{
+  VLC_UNUSED(p_this);
+  std::lock_guard<std::mutex> lock(g_varLock);
+  auto it = g_vars.find(psz_name);
+  if (it == g_vars.end())
+    return VLC_ENOVAR;
+  switch (i_type & VLC_VAR_CLASS)
+  {
+  case VLC_VAR_BOOL:
+    it->second.i_int = val.b_bool;
+    break;
+  case VLC_VAR_INTEGER:
+    it->second.i_int = val.i_int;
+    break;
+  case VLC_VAR_FLOAT:
+    it->second.f_float = val.f_float;
+    break;
+  case VLC_VAR_STRING:
+    it->second.psz_string = val.psz_string ? val.psz_string : "";
+    break;
+  default:
+    return VLC_EGENERIC;
+  }
+  return VLC_SUCCESS;
+}
+
+int (var_Inherit)(vlc_object_t* p_this, const char* psz_name, int i_type, vlc_value_t* p_val)
+{
+  VLC_UNUSED(p_this);
+  stub_var var;
+  {
+    std::lock_guard<std::mutex> lock(g_varLock);
+    auto it = g_config.find(psz_name);
+    if (it == g_config.end())
+      return VLC_ENOVAR;
+    var = it->second;
+  }
+  switch (i_type & VLC_VAR_CLASS)
+  {
+  case VLC_VAR_BOOL:
+    p_val->b_bool = var.i_int != 0;
+    break;
+  case VLC_VAR_INTEGER:
+    p_val->i_int = var.i_int;
+    break;
+  case VLC_VAR_FLOAT:
+    p_val->f_float = (float)var.f_float;
+    break;
+  case VLC_VAR_STRING:
+    p_val->psz_string = strdup(var.psz_string.c_str());
+    break;
+  default:
+    return VLC_EGENERIC;
+  }
+  return VLC_SUCCESS;
+}
+
+/*****************************************************************************
+ * Blocks
+ *****************************************************************************/
+static void BlockFree(block_t* p_block)
+{
+  free(p_block);
+}
+
+void block_Init(block_t* b, void* buf, size_t size)
+{
+  b->p_next = NULL;
+  b->p_buffer = (uint8_t*)buf;
+  b->i_buffer = size;
+  b->p_start = (uint8_t*)buf;
+  b->i_size = size;
+  b->i_flags = 0;
+  b->i_nb_samples = 0;
+  b->i_pts = b->i_dts = VLC_TS_INVALID;
+  b->i_length = 0;
+  b->pf_release = BlockFree;
+}
+
+block_t* block_Alloc(size_t i_size)
+{
+  static const size_t BLOCK_PADDING = 32;
+  block_t* b = (block_t*)malloc(sizeof(*b) + i_size + 2 * BLOCK_PADDING);
+  if (unlikely(b == NULL))
+    return NULL;
+  block_Init(b, (uint8_t*)(b + 1), i_size + 2 * BLOCK_PADDING);
+  b->p_buffer += BLOCK_PADDING;
+  b->i_buffer = i_size;
+  return b;
+}
+
+/*****************************************************************************
+ * Formats and pictures
+ *****************************************************************************/
+void es_format_Init(es_format_t* fmt, int i_cat, vlc_fourcc_t i_codec)
+{
+  memset(fmt, 0, sizeof(*fmt));
+  fmt->i_cat = i_cat;
+  fmt->i_codec = i_codec;
+  fmt->i_id = -1;
+  fmt->i_group = 0;
+  fmt->i_priority = ES_PRIORITY_SELECTABLE_MIN;
+}
+
+int es_format_Copy(es_format_t* dst, const es_format_t* src)
+{
+  *dst = *src;
+  dst->psz_language = NULL;
+  dst->psz_description = NULL;
+  dst->i_extra_languages = 0;
+  dst->p_extra_languages = NULL;
+  dst->p_extra = NULL;
+  dst->subs.psz_encoding = NULL;
+  dst->subs.p_style = NULL;
+  dst->video.p_palette = NULL;
+  if (src->i_extra > 0 && src->p_extra)
+  {
+    dst->p_extra = malloc(src->i_extra);
+    if (dst->p_extra == NULL)
+    {
+      dst->i_extra = 0;
+      return VLC_ENOMEM;
+    }
+    memcpy(dst->p_extra, src->p_extra, src->i_extra);
+  }
+  return VLC_SUCCESS;
+}
+
+void es_format_Clean(es_format_t* fmt)
+{
+  free(fmt->p_extra);
+  es_format_Init(fmt, UNKNOWN_ES, 0);
+}
+
+void video_format_Setup(video_format_t* p_fmt, vlc_fourcc_t i_chroma,
+  int i_width, int i_height, int i_visible_width, int i_visible_height,
+  int i_sar_num, int i_sar_den)
+{
+  p_fmt->i_chroma = i_chroma;
+  p_fmt->i_width = i_width;
+  p_fmt->i_visible_width = i_visible_width;
+  p_fmt->i_height = i_height;
+  p_fmt->i_visible_height = i_visible_height;
+  p_fmt->i_x_offset = p_fmt->i_y_offset = 0;
+  p_fmt->i_sar_num = i_sar_num;
+  p_fmt->i_sar_den = i_sar_den;
+  const vlc_chroma_description_t* dsc = vlc_fourcc_GetChromaDescription(i_chroma);
+  p_fmt->i_bits_per_pixel = 0;
+  if (dsc)
+  {
+    for (unsigned i = 0; i < dsc->plane_count; i++)
+      p_fmt->i_bits_per_pixel += dsc->pixel_bits * dsc->p[i].w.num * dsc->p[i].h.num / (dsc->p[i].w.den * dsc->p[i].h.den);
+  }
+}
+
+const vlc_chroma_description_t* vlc_fourcc_GetChromaDescription(vlc_fourcc_t i_fourcc)
+{
+  struct chroma_entry
+  {
+    vlc_fourcc_t fcc;
+    unsigned planes;
+    unsigned wden;
+    unsigned hden;
+    unsigned pixel_size;
+    unsigned pixel_bits;
+  };
+  static const chroma_entry entries[] = {
+    { VLC_CODEC_GREY,     1, 1, 1, 1, 8 },
+    { VLC_CODEC_I420,     3, 2, 2, 1, 8 },
+    { VLC_CODEC_I422,     3, 2, 1, 1, 8 },
+    { VLC_CODEC_I444,     3, 1, 1, 1, 8 },
+    { VLC_CODEC_I420_10L, 3, 2, 2, 2, 10 },
+    { VLC_CODEC_I422_10L, 3, 2, 1, 2, 10 },
+    { VLC_CODEC_I444_10L, 3, 1, 1, 2, 10 },
+    { VLC_CODEC_I420_12L, 3, 2, 2, 2, 12 },
+    { VLC_CODEC_I422_12L, 3, 2, 1, 2, 12 },
+    { VLC_CODEC_I444_12L, 3, 1, 1, 2, 12 },
+    // semi-planar: the interleaved chroma plane is as wide as the luma one in bytes
+    { VLC_CODEC_NV12,     2, 1, 2, 1, 8 },
+    { VLC_CODEC_P010,     2, 1, 2, 2, 10 },
+  };
+  static vlc_chroma_description_t descriptions[ARRAY_SIZE(entries)];
+  static std::once_flag init;
+  std::call_once(init, []() {
+    for (size_t i = 0; i < ARRAY_SIZE(entries); i++)
+    {
+      vlc_chroma_description_t& dsc = descriptions[i];
+      memset(&dsc, 0, sizeof(dsc));
+      dsc.plane_count = entries[i].planes;
+      for (unsigned p = 0; p < entries[i].planes; p++)
+      {
+        dsc.p[p].w.num = dsc.p[p].h.num = 1;
+        dsc.p[p].w.den = (p == 0) ? 1 : entries[i].wden;
+        dsc.p[p].h.den = (p == 0) ? 1 : entries[i].hden;
+      }
+      dsc.pixel_size = entries[i].pixel_size;
+      dsc.pixel_bits = entries[i].pixel_bits;
+    }
+  });
+  for (size_t i = 0; i < ARRAY_SIZE(entries); i++)
+  {
+    if (entries[i].fcc == i_fourcc)
+      return &descriptions[i];
+  }
+  return NULL;
+}
+
+namespace
+{
+  struct stub_picture
+  {
+    picture_t picture;
+    std::atomic<int> refs;
+    uint8_t* p_data;
+  };
+}
+
+picture_t* picture_NewFromFormat(const video_format_t* p_fmt)
+{
+  const vlc_chroma_description_t* dsc = vlc_fourcc_GetChromaDescription(p_fmt->i_chroma);
+  if (dsc == NULL)
+    return NULL;
+
+  stub_picture* p_stub = new stub_picture;
+  picture_t* p_pic = &p_stub->picture;
+  memset(p_pic, 0, sizeof(*p_pic));
+  p_stub->refs = 1;
+  p_pic->format = *p_fmt;
+  p_pic->i_planes = dsc->plane_count;
+
+  size_t i_total = 0;
+  for (unsigned i = 0; i < dsc->plane_count; i++)
+  {
+    plane_t* p = &p_pic->p[i];
+    const unsigned width = (p_fmt->i_width + 63) & ~63;
+    p->i_lines = p_fmt->i_height * dsc->p[i].h.num / dsc->p[i].h.den;
+    p->i_visible_lines = p_fmt->i_visible_height * dsc->p[i].h.num / dsc->p[i].h.den;
+    p->i_pitch = width * dsc->p[i].w.num / dsc->p[i].w.den * dsc->pixel_size;
+    p->i_visible_pitch = p_fmt->i_visible_width * dsc->p[i].w.num / dsc->p[i].w.den * dsc->pixel_size;
+    p->i_pixel_pitch = dsc->pixel_size;
+    i_total += (size_t)p->i_pitch * p->i_lines;
+  }
+  p_stub->p_data = (uint8_t*)aligned_alloc(64, (i_total + 63) & ~(size_t)63);
+  if (p_stub->p_data == NULL)
+  {
+    delete p_stub;
+    return NULL;
+  }
+  uint8_t* p_pixels = p_stub->p_data;
+  for (int i = 0; i < p_pic->i_planes; i++)
+  {
+    p_pic->p[i].p_pixels = p_pixels;
+    p_pixels += (size_t)p_pic->p[i].i_pitch * p_pic->p[i].i_lines;
+  }
+  return p_pic;
+}
+
+picture_t* picture_Hold(picture_t* p_picture)
+{
+  ((stub_picture*)p_picture)->refs++;
+  return p_picture;
+}
+
+void picture_Release(picture_t* p_picture)
+{
+  stub_picture* p_stub = (stub_picture*)p_picture;
+  if (--p_stub->refs == 0)
+  {
+    free(p_stub->p_data);
+    delete p_stub;
+  }
+}
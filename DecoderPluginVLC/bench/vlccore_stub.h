@@ -0,0 +1,36 @@
+/*****************************************************************************
+ * vlccore_stub.h: minimal libvlccore replacement for the benchmark driver
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VLCCORE_STUB_H_
+#define VLCCORE_STUB_H_
+
+#include <stdint.h>
+
+namespace BenchStub
+{
+  void SetVerbosity(int verbosity);
+  /* default value of a module option, as declared in the module descriptor */
+  void ConfigDefault(const char* psz_name, int type, int64_t i_value, double f_value, const char* psz_value);
+  /* user value of a module option (--name=value), takes precedence over the default */
+  void ConfigSet(const char* psz_name, const char* psz_value);
+}
+
+#endif // VLCCORE_STUB_H_
@@ -0,0 +1,690 @@
+/*****************************************************************************
+ * vvcdec_bench.cpp: headless benchmark of the packetizer + decoder pipeline
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * usage: vvcdec_bench [-v] [--fps=N] [--psnr] [--<module option>=<value> ...] file.266
+ *        vvcdec_bench --copy
+ *
+ * The .266 annexB file is read in chunks, packetized (PacketizeAnnexB),
+ * decoded (DecodeFrame) and the output pictures are released right away.
+ * Modules are loaded through their descriptor, like VLC does, and module
+ * options can be given on the command line.
+ *
+ * With --psnr, every access unit is also decoded by a second decoder at
+ * vvc-decode-level 0, and the luma PSNR of the output pictures against this
+ * reference is reported: the cost in quality of the tested decode level.
+ * The timings then include the reference decoding.
+ *
+ * With --copy, no file is decoded: the throughput of each copy kernel of
+ * vvc_picture_copy (C, SSE4.1, AVX2 up to what the cpu supports) is measured
+ * on synthetic planes, below and above STREAM_COPY_MIN_SIZE, with the 16-bit
+ * copy both as dispatched and forced to non-temporal stores. Beforehand, every
+ * form of the SIMD kernels is checked to give the same output as the C one,
+ * the bench fails otherwise.
+ *****************************************************************************/
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <math.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <vlc_common.h>
+#include <vlc_plugin.h>
+#include <vlc_codec.h>
+#include <vlc_picture.h>
+
+#include "vlccore_stub.h"
+#include "vvc_picture_copy.h"
+
+#define VLC_CODEC_VVC VLC_FOURCC('h','2','6','6')
+
+extern "C" int VLC_SYMBOL(vlc_entry)(vlc_set_cb, void*);
+
+namespace VvcDecoder
+{
+  // the demuxer is not part of the benchmark
+  int OpenDemux(vlc_object_t*) { return VLC_EGENERIC; }
+  void CloseDemux(vlc_object_t*) {}
+}
+
+/*****************************************************************************
+ * Module loading: only keeps the capabilities, callbacks and option defaults
+ *****************************************************************************/
+struct bench_module
+{
+  std::string capability;
+  int (*pf_open)(vlc_object_t*);
+  void (*pf_close)(vlc_object_t*);
+};
+
+struct bench_config
+{
+  int type;
+  std::string name;
+};
+
+static std::vector<bench_module*> g_modules;
+static std::vector<bench_config*> g_configs;
+
+static int BenchSet(void* opaque, void* target, int property, ...)
+{
+  VLC_UNUSED(opaque);
+  va_list ap;
+  va_start(ap, property);
+  switch (property)
+  {
+  case VLC_MODULE_CREATE:
+  {
+    module_t** pp_module = va_arg(ap, module_t**);
+    g_modules.push_back(new bench_module());
+    *pp_module = (module_t*)g_modules.back();
+    break;
+  }
+  case VLC_CONFIG_CREATE:
+  {
+    int type = va_arg(ap, int);
+    module_config_t** pp_config = va_arg(ap, module_config_t**);
+    g_configs.push_back(new bench_config());
+    g_configs.back()->type = type;
+    *pp_config = (module_config_t*)g_configs.back();
+    break;
+  }
+  case VLC_MODULE_CAPABILITY:
+    ((bench_module*)target)->capability = va_arg(ap, const char*);
+    break;
+  case VLC_MODULE_CB_OPEN:
+    va_arg(ap, const char*);
+    ((bench_module*)target)->pf_open = (int(*)(vlc_object_t*))va_arg(ap, void*);
+    break;
+  case VLC_MODULE_CB_CLOSE:
+    va_arg(ap, const char*);
+    ((bench_module*)target)->pf_close = (void(*)(vlc_object_t*))va_arg(ap, void*);
+    break;
+  case VLC_CONFIG_NAME:
+    ((bench_config*)target)->name = va_arg(ap, const char*);
+    break;
+  case VLC_CONFIG_VALUE:
+  {
+    bench_config* cfg = (bench_config*)target;
+    if (IsConfigStringType(cfg->type))
+      BenchStub::ConfigDefault(cfg->name.c_str(), cfg->type, 0, 0., va_arg(ap, const char*));
+    else if (IsConfigFloatType(cfg->type))
+      BenchStub::ConfigDefault(cfg->name.c_str(), cfg->type, 0, va_arg(ap, double), NULL);
+    else
+    {
+      int64_t value = va_arg(ap, int64_t);
+      if (!cfg->name.empty())
+        BenchStub::ConfigDefault(cfg->name.c_str(), cfg->type, value, (double)value, NULL);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+  va_end(ap);
+  return 0;
+}
+
+static bench_module* FindModule(const char* psz_capability)
+{
+  for (bench_module* m : g_modules)
+  {
+    if (m->capability == psz_capability)
+      return m;
+  }
+  return NULL;
+}
+
+/*****************************************************************************
+ * Decoder owner: null picture sink
+ *****************************************************************************/
+struct bench_sink
+{
+  size_t nb_pictures;
+  mtime_t first_picture;
+  mtime_t last_picture;
+
+  // PSNR against the reference decoder (--psnr)
+  decoder_t* p_ref;
+  std::mutex lock; // the decoders may output from their own threads
+  std::deque<picture_t*> pictures;
+  std::deque<picture_t*> ref_pictures;
+  size_t nb_compared;
+  double sse;
+  double samples;
+  double max_value;
+  double min_psnr;
+};
+static bench_sink g_sink;
+
+static double LumaSse(const picture_t* p_pic, const picture_t* p_ref)
+{
+  const plane_t* a = &p_pic->p[0];
+  const plane_t* b = &p_ref->p[0];
+  const int width = a->i_visible_pitch / a->i_pixel_pitch;
+  const int lines = a->i_visible_lines;
+  double sse = 0.;
+  for (int y = 0; y < lines; y++)
+  {
+    const uint8_t* pa = a->p_pixels + (size_t)y * a->i_pitch;
+    const uint8_t* pb = b->p_pixels + (size_t)y * b->i_pitch;
+    int64_t line_sse = 0;
+    for (int x = 0; x < width; x++)
+    {
+      const int d = a->i_pixel_pitch == 2 ? ((const uint16_t*)pa)[x] - ((const uint16_t*)pb)[x] : pa[x] - pb[x];
+      line_sse += d * d;
+    }
+    sse += line_sse;
+  }
+  g_sink.samples += (double)width * lines;
+  return sse;
+}
+
+static void ComparePictures()
+{
+  while (!g_sink.pictures.empty() && !g_sink.ref_pictures.empty())
+  {
+    picture_t* p_pic = g_sink.pictures.front();
+    picture_t* p_ref = g_sink.ref_pictures.front();
+    g_sink.pictures.pop_front();
+    g_sink.ref_pictures.pop_front();
+    if (p_pic->format.i_chroma == p_ref->format.i_chroma &&
+      p_pic->p[0].i_visible_pitch == p_ref->p[0].i_visible_pitch &&
+      p_pic->p[0].i_visible_lines == p_ref->p[0].i_visible_lines)
+    {
+      const vlc_chroma_description_t* dsc = vlc_fourcc_GetChromaDescription(p_pic->format.i_chroma);
+      g_sink.max_value = (1 << (dsc ? dsc->pixel_bits : 8)) - 1;
+      const double samples = g_sink.samples;
+      const double sse = LumaSse(p_pic, p_ref);
+      g_sink.sse += sse;
+      if (sse > 0.)
+        g_sink.min_psnr = std::min(g_sink.min_psnr,
+          10. * log10(g_sink.max_value * g_sink.max_value * (g_sink.samples - samples) / sse));
+      g_sink.nb_compared++;
+    }
+    picture_Release(p_pic);
+    picture_Release(p_ref);
+  }
+}
+
+static int SinkFormatUpdate(decoder_t* p_dec)
+{
+  VLC_UNUSED(p_dec);
+  return 0;
+}
+
+static picture_t* SinkNewPicture(decoder_t* p_dec)
+{
+  return picture_NewFromFormat(&p_dec->fmt_out.video);
+}
+
+static int SinkQueueVideo(decoder_t* p_dec, picture_t* p_pic)
+{
+  std::lock_guard<std::mutex> lock(g_sink.lock);
+  if (p_dec == g_sink.p_ref)
+  {
+    g_sink.ref_pictures.push_back(p_pic);
+    ComparePictures();
+    return 0;
+  }
+  if (!g_sink.nb_pictures)
+    g_sink.first_picture = mdate();
+  g_sink.last_picture = mdate();
+  g_sink.nb_pictures++;
+  if (g_sink.p_ref)
+  {
+    g_sink.pictures.push_back(p_pic);
+    ComparePictures();
+  }
+  else
+    picture_Release(p_pic);
+  return 0;
+}
+
+static decoder_t* CreateDecoder(const char* psz_capability, const es_format_t* p_fmt)
+{
+  bench_module* p_module = FindModule(psz_capability);
+  if (p_module == NULL)
+    return NULL;
+  decoder_t* p_dec = (decoder_t*)calloc(1, sizeof(*p_dec));
+  if (p_dec == NULL)
+    return NULL;
+  p_dec->p_module = (module_t*)p_module;
+  es_format_Copy(&p_dec->fmt_in, p_fmt);
+  es_format_Init(&p_dec->fmt_out, VIDEO_ES, 0);
+  p_dec->pf_vout_format_update = SinkFormatUpdate;
+  p_dec->pf_vout_buffer_new = SinkNewPicture;
+  p_dec->pf_queue_video = SinkQueueVideo;
+  if (p_module->pf_open(VLC_OBJECT(p_dec)) != VLC_SUCCESS)
+  {
+    es_format_Clean(&p_dec->fmt_in);
+    free(p_dec);
+    return NULL;
+  }
+  return p_dec;
+}
+
+static void DeleteDecoder(decoder_t* p_dec)
+{
+  ((bench_module*)p_dec->p_module)->pf_close(VLC_OBJECT(p_dec));
+  es_format_Clean(&p_dec->fmt_in);
+  es_format_Clean(&p_dec->fmt_out);
+  free(p_dec);
+}
+
+/*****************************************************************************
+ * Copy kernels (--copy)
+ *****************************************************************************/
+struct copy_bench_plane
+{
+  std::vector<short> src;
+  std::vector<uint8_t> dst;
+  int width;  // in samples
+  int lines;
+  int src_stride; // in samples
+  int dst_pitch;  // in bytes, for 16-bit samples interleaved
+  uint8_t* p_dst;
+};
+
+static void CopyBenchInit(copy_bench_plane* p, int width, int lines, int bitDepth)
+{
+  p->width = width;
+  p->lines = lines;
+  p->src_stride = (width + 63) & ~31; // not a multiple of the cache line
+  p->dst_pitch = (width * 4 + 63) & ~63;
+  p->src.resize((size_t)p->src_stride * lines * 2); // Cb and Cr
+  uint32_t seed = 1;
+  for (size_t i = 0; i < p->src.size(); i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    p->src[i] = (short)((seed >> 16) & ((1 << bitDepth) - 1));
+  }
+  p->dst.resize((size_t)p->dst_pitch * lines + 64);
+  p->p_dst = (uint8_t*)(((uintptr_t)p->dst.data() + 63) & ~(uintptr_t)63);
+}
+
+/* the Cr plane, after the Cb one */
+static const short* CopyBenchSrcV(const copy_bench_plane* p)
+{
+  return p->src.data() + (size_t)p->src_stride * p->lines;
+}
+
+/* runs a kernel of impl and its C version on the same source, returns false
+ * if the lineBytes first bytes of the lines they write differ */
+template <typename F>
+static bool CopyCheckSame(const char* psz_kernel, VvcDecoder::copy_impl_e impl, copy_bench_plane* p,
+  int lines, size_t lineBytes, F f)
+{
+  std::vector<uint8_t> ref((size_t)p->dst_pitch * lines, 0xcd);
+  memset(p->p_dst, 0xcd, (size_t)p->dst_pitch * lines);
+  f(VvcDecoder::COPY_IMPL_C, ref.data());
+  f(impl, p->p_dst);
+  for (int y = 0; y < lines; y++)
+  {
+    if (memcmp(ref.data() + (size_t)y * p->dst_pitch, p->p_dst + (size_t)y * p->dst_pitch, lineBytes))
+    {
+      printf("mismatch: %s %s %dx%d, line %d\n", psz_kernel, VvcDecoder::GetCopyImplName(impl), p->width, p->lines, y);
+      return false;
+    }
+  }
+  return true;
+}
+
+/* every form of every kernel gives the same output as its C version, on
+ * widths that leave SIMD tails */
+static bool CheckCopyKernels(VvcDecoder::copy_impl_e impl)
+{
+  using namespace VvcDecoder;
+  static const int sizes[][2] = { { 70, 18 }, { 333, 37 }, { 1920, 64 } };
+  bool b_ok = true;
+  for (const auto& size : sizes)
+  {
+    copy_bench_plane planes[3];
+    CopyBenchInit(&planes[0], size[0], size[1], 8);
+    CopyBenchInit(&planes[1], size[0], size[1], 10);
+    CopyBenchInit(&planes[2], size[0], size[1], 12);
+    copy_bench_plane* p8 = &planes[0];
+    copy_bench_plane* p10 = &planes[1];
+    copy_bench_plane* p12 = &planes[2];
+    const int w = size[0], h = size[1];
+    b_ok &= CopyCheckSame("copy narrow", impl, p8, h, w, [&](copy_impl_e i, uint8_t* dst) {
+      GetCopyPlaneNarrow(i)(dst, p8->dst_pitch, p8->src.data(), p8->src_stride, w, h); });
+    b_ok &= CopyCheckSame("copy wide", impl, p10, h, 2 * w, [&](copy_impl_e i, uint8_t* dst) {
+      GetCopyPlane(i)(dst, p10->dst_pitch, p10->src.data(), p10->src_stride, 2 * w, h); });
+    if (GetCopyPlaneStream(impl))
+      b_ok &= CopyCheckSame("copy wide stream", impl, p10, h, 2 * w, [&](copy_impl_e i, uint8_t* dst) {
+        (i == COPY_IMPL_C ? GetCopyPlane(i) : GetCopyPlaneStream(i))(dst, p10->dst_pitch, p10->src.data(), p10->src_stride, 2 * w, h); });
+    b_ok &= CopyCheckSame("copy shift", impl, p10, h, 2 * w, [&](copy_impl_e i, uint8_t* dst) {
+      GetCopyPlaneShift(i)(dst, p10->dst_pitch, p10->src.data(), p10->src_stride, w, h, 6); });
+    b_ok &= CopyCheckSame("interleave narrow", impl, p8, h, 2 * w, [&](copy_impl_e i, uint8_t* dst) {
+      GetInterleavePlaneNarrow(i)(dst, p8->dst_pitch, p8->src.data(), CopyBenchSrcV(p8), p8->src_stride, w, h); });
+    for (int shift : { 0, 6 })
+      b_ok &= CopyCheckSame("interleave wide", impl, p10, h, 4 * w, [&](copy_impl_e i, uint8_t* dst) {
+        GetInterleavePlane(i)(dst, p10->dst_pitch, p10->src.data(), CopyBenchSrcV(p10), p10->src_stride, w, h, shift); });
+    for (copy_bench_plane* p : { p10, p12 })
+    {
+      const int shift = p == p10 ? 2 : 4;
+      b_ok &= CopyCheckSame("copy dither", impl, p, h, w, [&](copy_impl_e i, uint8_t* dst) {
+        GetCopyPlaneDither(i)(dst, p->dst_pitch, p->src.data(), p->src_stride, w, h, shift); });
+      b_ok &= CopyCheckSame("interleave dither", impl, p, h, 2 * w, [&](copy_impl_e i, uint8_t* dst) {
+        GetInterleavePlaneDither(i)(dst, p->dst_pitch, p->src.data(), CopyBenchSrcV(p), p->src_stride, w, h, shift); });
+    }
+    // 8-bit output, dithered from 10 and 12 bits, and 16-bit output, shifted or not
+    const struct { copy_bench_plane* p; int sampleSize; int shift; } forms[] = {
+      { p8, 1, 0 }, { p10, 1, 2 }, { p12, 1, 4 }, { p10, 2, 0 }, { p10, 2, 6 }, { p12, 2, 4 },
+    };
+    for (int log2Factor = 1; log2Factor <= 2; log2Factor++)
+    {
+      const int dw = w >> log2Factor, dh = h >> log2Factor;
+      for (const auto& form : forms)
+      {
+        copy_bench_plane* p = form.p;
+        b_ok &= CopyCheckSame("downscale", impl, p, dh, dw * form.sampleSize, [&](copy_impl_e i, uint8_t* dst) {
+          GetDownscalePlane(i)(dst, p->dst_pitch, p->src.data(), NULL, p->src_stride, dw, dh, log2Factor, form.sampleSize, form.shift); });
+        b_ok &= CopyCheckSame("downscale interleave", impl, p, dh, 2 * dw * form.sampleSize, [&](copy_impl_e i, uint8_t* dst) {
+          GetDownscalePlane(i)(dst, p->dst_pitch, p->src.data(), CopyBenchSrcV(p), p->src_stride, dw, dh, log2Factor, form.sampleSize, form.shift); });
+      }
+    }
+  }
+  return b_ok;
+}
+
+/* runs the kernel until at least 0.2 s have elapsed and returns the time of one call */
+template <typename F>
+static double CopyBenchTime(F f)
+{
+  f(); // page in the destination
+  int runs = 0;
+  const mtime_t t_start = mdate();
+  mtime_t t_elapsed;
+  do
+  {
+    f();
+    runs++;
+    t_elapsed = mdate() - t_start;
+  } while (t_elapsed < CLOCK_FREQ / 5 || runs < 3);
+  return t_elapsed / (double)CLOCK_FREQ / runs;
+}
+
+static void CopyBenchPrint(const char* psz_kernel, VvcDecoder::copy_impl_e impl, const char* psz_store,
+  const copy_bench_plane* p, size_t dst_bytes, double seconds)
+{
+  char name[64];
+  snprintf(name, sizeof(name), "%s %s%s", psz_kernel, VvcDecoder::GetCopyImplName(impl), psz_store);
+  printf("%-28s %4dx%-4d %7.1f KB %7.2f GB/s %8.1f Msamples/s\n", name, p->width, p->lines,
+    dst_bytes / 1024., dst_bytes / seconds / 1e9, (double)p->width * p->lines / seconds / 1e6);
+}
+
+static bool RunCopyBench()
+{
+  using namespace VvcDecoder;
+  // 8-bit and 10-bit planes (shift 2 for the dither, 6 for P010 like outputs)
+  static const int sizes[][2] = { { 640, 360 }, { 1920, 1080 }, { 3840, 2160 } };
+  bool b_ok = true;
+  for (int i = COPY_IMPL_SSE4_1; i <= GetCopyImpl(); i++)
+  {
+    const bool b_same = CheckCopyKernels((copy_impl_e)i);
+    printf("check %-22s %s\n", GetCopyImplName((copy_impl_e)i), b_same ? "same output as c" : "FAILED");
+    b_ok &= b_same;
+  }
+  if (!b_ok)
+    return false;
+  printf("streaming stores of the 16-bit copy from %zu KB\n", STREAM_COPY_MIN_SIZE / 1024);
+  for (const auto& size : sizes)
+  {
+    copy_bench_plane plane;
+    copy_bench_plane* p = &plane;
+    CopyBenchInit(p, size[0], size[1], 8);
+    const short* p_src = p->src.data();
+    const short* p_src_v = CopyBenchSrcV(p);
+    const int w = p->width, h = p->lines;
+    const size_t narrow = (size_t)w * h, wide = narrow * 2;
+    for (int i = COPY_IMPL_C; i <= GetCopyImpl(); i++)
+    {
+      const copy_impl_e impl = (copy_impl_e)i;
+      copy_plane_narrow_t copyNarrow = GetCopyPlaneNarrow(impl);
+      copy_plane_t copy = GetCopyPlane(impl);
+      copy_plane_t copyStream = GetCopyPlaneStream(impl);
+      copy_plane_shift_t copyShift = GetCopyPlaneShift(impl);
+      copy_plane_dither_t copyDither = GetCopyPlaneDither(impl);
+      interleave_plane_narrow_t interleaveNarrow = GetInterleavePlaneNarrow(impl);
+      interleave_plane_t interleave = GetInterleavePlane(impl);
+      interleave_plane_dither_t interleaveDither = GetInterleavePlaneDither(impl);
+      downscale_plane_t downscale = GetDownscalePlane(impl);
+
+      CopyBenchPrint("copy narrow", impl, "", p, narrow, CopyBenchTime([&] {
+        copyNarrow(p->p_dst, p->dst_pitch, p_src, p->src_stride, w, h); }));
+      CopyBenchPrint("copy wide", impl, !copyStream || wide < STREAM_COPY_MIN_SIZE ? " memcpy" : " stream", p, wide,
+        CopyBenchTime([&] { copy(p->p_dst, p->dst_pitch, p_src, p->src_stride, w * 2, h); }));
+      if (copyStream)
+      {
+        // the other side of the threshold
+        if (wide < STREAM_COPY_MIN_SIZE)
+          CopyBenchPrint("copy wide", impl, " stream", p, wide, CopyBenchTime([&] {
+            copyStream(p->p_dst, p->dst_pitch, p_src, p->src_stride, w * 2, h); }));
+        else
+          CopyBenchPrint("copy wide", impl, " memcpy", p, wide, CopyBenchTime([&] {
+            GetCopyPlane(COPY_IMPL_C)(p->p_dst, p->dst_pitch, p_src, p->src_stride, w * 2, h); }));
+      }
+      CopyBenchPrint("copy shift", impl, "", p, wide, CopyBenchTime([&] {
+        copyShift(p->p_dst, p->dst_pitch, p_src, p->src_stride, w, h, 6); }));
+      CopyBenchPrint("copy dither", impl, "", p, narrow, CopyBenchTime([&] {
+        copyDither(p->p_dst, p->dst_pitch, p_src, p->src_stride, w, h, 2); }));
+      CopyBenchPrint("interleave narrow", impl, "", p, wide, CopyBenchTime([&] {
+        interleaveNarrow(p->p_dst, p->dst_pitch, p_src, p_src_v, p->src_stride, w, h); }));
+      CopyBenchPrint("interleave wide", impl, "", p, wide * 2, CopyBenchTime([&] {
+        interleave(p->p_dst, p->dst_pitch, p_src, p_src_v, p->src_stride, w, h, 6); }));
+      CopyBenchPrint("interleave dither", impl, "", p, wide, CopyBenchTime([&] {
+        interleaveDither(p->p_dst, p->dst_pitch, p_src, p_src_v, p->src_stride, w, h, 2); }));
+      // source plane of the size above, downscaled by 2
+      CopyBenchPrint("downscale 1/2", impl, "", p, narrow / 4, CopyBenchTime([&] {
+        downscale(p->p_dst, p->dst_pitch, p_src, NULL, p->src_stride, w / 2, h / 2, 1, 1, 0); }));
+    }
+  }
+  return true;
+}
+
+/*****************************************************************************
+ * main
+ *****************************************************************************/
+static void Usage(const char* psz_prog)
+{
+  fprintf(stderr, "usage: %s [-v] [--fps=N] [--psnr] [--<module option>=<value> ...] file.266\n", psz_prog);
+  fprintf(stderr, "       %s --copy\n", psz_prog);
+}
+
+int main(int argc, char** argv)
+{
+  const char* psz_file = NULL;
+  double fps = 50.;
+  bool b_psnr = false;
+  std::string decode_level = "0";
+  // pacing is meaningless without a clock: do not let hurry-up mode skip work
+  BenchStub::ConfigSet("vvc-enable-hurry-mode", "0");
+  BenchStub::ConfigSet("vvc-stats-interval", "1");
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-v"))
+      BenchStub::SetVerbosity(VLC_MSG_DBG);
+    else if (!strncmp(argv[i], "--fps=", 6))
+      fps = atof(argv[i] + 6);
+    else if (!strcmp(argv[i], "--psnr"))
+      b_psnr = true;
+    else if (!strcmp(argv[i], "--copy"))
+    {
+      return RunCopyBench() ? 0 : 1;
+    }
+    else if (!strncmp(argv[i], "--", 2) && strchr(argv[i], '='))
+    {
+      std::string opt(argv[i] + 2);
+      const size_t eq = opt.find('=');
+      BenchStub::ConfigSet(opt.substr(0, eq).c_str(), opt.substr(eq + 1).c_str());
+      if (opt.substr(0, eq) == "vvc-decode-level")
+        decode_level = opt.substr(eq + 1);
+    }
+    else if (!psz_file)
+      psz_file = argv[i];
+    else
+    {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  if (!psz_file || fps <= 0.)
+  {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  FILE* f = fopen(psz_file, "rb");
+  if (!f)
+  {
+    fprintf(stderr, "cannot open %s\n", psz_file);
+    return 1;
+  }
+
+  if (VLC_SYMBOL(vlc_entry)(BenchSet, NULL))
+  {
+    fprintf(stderr, "module descriptor failed\n");
+    return 1;
+  }
+
+  es_format_t fmt;
+  es_format_Init(&fmt, VIDEO_ES, VLC_CODEC_VVC);
+  decoder_t* p_pack = CreateDecoder("packetizer", &fmt);
+  fmt.b_packetized = true;
+  g_sink.min_psnr = HUGE_VAL;
+  if (b_psnr && p_pack)
+  {
+    // the options are read when the decoders are opened
+    BenchStub::ConfigSet("vvc-decode-level", "0");
+    g_sink.p_ref = CreateDecoder("video decoder", &fmt);
+    BenchStub::ConfigSet("vvc-decode-level", decode_level.c_str());
+  }
+  decoder_t* p_dec = p_pack ? CreateDecoder("video decoder", &fmt) : NULL;
+  if (!p_pack || !p_dec || (b_psnr && !g_sink.p_ref))
+  {
+    fprintf(stderr, "cannot open packetizer/decoder\n");
+    return 1;
+  }
+
+  static const size_t CHUNK_SIZE = 2048 * 16;
+  date_t dts;
+  date_Init(&dts, (uint32_t)(fps * 1000), 1000);
+  date_Set(&dts, VLC_TS_0);
+  mtime_t t_read = 0, t_packetize = 0, t_decode = 0;
+  size_t nb_au = 0;
+  const mtime_t t_start = mdate();
+  bool b_eof = false;
+  while (!b_eof)
+  {
+    mtime_t t0 = mdate();
+    block_t* p_block = block_Alloc(CHUNK_SIZE);
+    p_block->i_buffer = fread(p_block->p_buffer, 1, CHUNK_SIZE, f);
+    if (p_block->i_buffer == 0)
+    {
+      block_Release(p_block);
+      p_block = NULL;
+      b_eof = true;
+    }
+    else
+    {
+      p_block->i_dts = date_Get(&dts);
+    }
+    mtime_t t1 = mdate();
+    t_read += t1 - t0;
+
+    block_t* p_au;
+    while ((p_au = p_pack->pf_packetize(p_pack, p_block ? &p_block : NULL)))
+    {
+      while (p_au)
+      {
+        block_t* p_next = p_au->p_next;
+        p_au->p_next = NULL;
+        nb_au++;
+        date_Increment(&dts, 1);
+        mtime_t t2 = mdate();
+        t_packetize += t2 - t1;
+        if (g_sink.p_ref)
+        {
+          block_t* p_dup = block_Duplicate(p_au);
+          if (p_dup)
+            g_sink.p_ref->pf_decode(g_sink.p_ref, p_dup);
+        }
+        p_dec->pf_decode(p_dec, p_au);
+        t1 = mdate();
+        t_decode += t1 - t2;
+        p_au = p_next;
+      }
+    }
+    t_packetize += mdate() - t1;
+  }
+  // drain
+  mtime_t t2 = mdate();
+  if (g_sink.p_ref)
+    g_sink.p_ref->pf_decode(g_sink.p_ref, NULL);
+  p_dec->pf_decode(p_dec, NULL);
+  t_decode += mdate() - t2;
+  const mtime_t t_total = mdate() - t_start;
+  fclose(f);
+
+  DeleteDecoder(p_dec);
+  if (g_sink.p_ref)
+  {
+    DeleteDecoder(g_sink.p_ref);
+    for (picture_t* p_pic : g_sink.pictures)
+      picture_Release(p_pic);
+    for (picture_t* p_pic : g_sink.ref_pictures)
+      picture_Release(p_pic);
+  }
+  DeleteDecoder(p_pack);
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  const double seconds = t_total / (double)CLOCK_FREQ;
+  printf("file          %s\n", psz_file);
+  printf("access units  %zu\n", nb_au);
+  printf("pictures      %zu\n", g_sink.nb_pictures);
+  printf("total         %.3f s, %.2f fps\n", seconds, seconds > 0 ? g_sink.nb_pictures / seconds : 0.);
+  printf("read          %.3f s\n", t_read / (double)CLOCK_FREQ);
+  printf("packetize     %.3f s\n", t_packetize / (double)CLOCK_FREQ);
+  printf("decode+output %.3f s\n", t_decode / (double)CLOCK_FREQ);
+  printf("peak rss      %.1f MB\n", usage.ru_maxrss / 1024.);
+  if (b_psnr)
+  {
+    printf("decode level  %s\n", decode_level.c_str());
+    printf("compared      %zu pictures\n", g_sink.nb_compared);
+    if (g_sink.sse > 0.)
+      printf("luma psnr     %.2f dB (min %.2f dB)\n",
+        10. * log10(g_sink.max_value * g_sink.max_value * g_sink.samples / g_sink.sse), g_sink.min_psnr);
+    else
+      printf("luma psnr     identical\n");
+  }
+  return 0;
+}
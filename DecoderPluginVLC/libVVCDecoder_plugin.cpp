@@ -34,7 +34,10 @@
 #endif
 
 #include <algorithm>
+#include <cstdlib>
+#include <deque>
 #include <memory>
+#include <set>
 #include <vector>
 #include "LibVTMDec.h"
 
@@ -46,6 +49,14 @@
 #include <vlc_codec.h>
 #include <vlc_dialog.h>
 
+#include "vvc_picture_copy.h"
+#include "vvc_spsc_queue.h"
+#include "vvc_nal.h"
+#include "vvc_stats.h"
+#include "vvc_cpu.h"
+#include "vvc_instance_cache.h"
+#include "vvc_band_pool.h"
+
 #define N_(str) (str)
 
   /*****************************************************************************
@@ -73,13 +84,32 @@ struct decoder_sys_t
   static const int MAX_SPEED_UP_LEVEL = 4;
   static const int SPDUP_DELAY_BASE = 10;
   int speedUpLevel;
+  // decode levels: fixed minimum, and maximum reached by hurry-up mode
+  int minSpeedUpLevel;
+  int maxSpeedUpLevel;
   int speedUpLevel_delai_increase;
   int speedUpLevel_delai_decrease;
   mtime_t speedUpLevel_previous_lateness;
   mtime_t speedUpLevel_delai_derivative;
-  mtime_t dts1;
-  mtime_t diff_dts;
-  mtime_t dts2;
+  // sub-layer dropping: non-reference pictures with TemporalId >= dropTid are not decoded
+  static const int MAX_TEMPORAL_ID = 6;
+  int maxTid;
+  int dropTid;
+  int nbDroppedPictures;
+  size_t drop_frame_count;
+  // frame rate detection from the dts of the input blocks
+  static const size_t FPS_DETECT_WINDOW = 32;
+  static const size_t FPS_DETECT_MIN_DELTAS = 8;
+  mtime_t lastDetect_dts;
+  std::vector<mtime_t> dtsDeltas;
+  // flush: pictures left in the decoder are discarded, decoding resumes at the next IRAP
+  bool b_discard_output;
+  bool b_wait_irap;
+  bool b_skip_rasl;
+  mtime_t preroll_end;      // pictures before are not output, INT64_MAX while prerolling
+  size_t preroll_frame_count;
+  mtime_t flush_time;
+  mtime_t seekLatency;      // from the last flush to the next output picture
   size_t dec_frame_count;
   size_t out_frame_count;
   struct layer_info
@@ -91,7 +121,92 @@ struct decoder_sys_t
     int posy;
   };
   std::vector<layer_info> outputLayers;
+  int layoutWidth;          // size of the composition of the output layers
+  int layoutHeight;
+  // output format negotiation
+  unsigned int colourDesc[6];   // colour description reported by VTM when the format was set
+  bool b_vout_ready;            // the last decoder_UpdateVideoFormat succeeded
+  size_t format_update_count;
+  // output pictures allocated on top of the vout ones, from the SPS DPB size
+  int maxExtraPictureBuffers;
+  // low-delay streams (no reordering): pictures take the timestamp of their access unit
+  bool b_low_delay_mode;
+  bool b_low_delay;
+  std::deque<mtime_t> pendingPts;
+  // reordered output: the timestamps of the decoded access units, output in
+  // increasing order; without timestamps in the blocks they are extrapolated
+  std::multiset<mtime_t> reorderedPts;
+  bool b_reorderedPts;
+  // trick-play: the packetizer only passes IRAPs, output in decoding order
+  bool b_irap_only;
+  // thumbnail: a single IRAP is decoded and output
+  bool b_thumbnail;
+  bool b_thumbnail_done;
+  // picture being filled, the layers of an output picture go to the same one; a copy
+  // outside of the vout pool (b_pic_copy) when no vout picture was ready
   picture_t* p_pic;
+  bool b_pic_copy;
+  // vout picture taken ahead, outside of vtm_lock: the vout can block
+  picture_t* p_spare;
+  VvcDecoder::copy_plane_narrow_t pf_copy_narrow;
+  VvcDecoder::copy_plane_t pf_copy;
+  // semi-planar output of 4:2:0 8/10-bit streams (NV12/P010)
+  bool b_semiplanar;
+  VvcDecoder::copy_plane_shift_t pf_copy_shift;
+  VvcDecoder::interleave_plane_narrow_t pf_interleave_narrow;
+  VvcDecoder::interleave_plane_t pf_interleave;
+  // 0: stream bit depth, 8: higher bit depths are dithered down to 8 bits
+  int outputDepth;
+  VvcDecoder::copy_plane_dither_t pf_copy_dither;
+  VvcDecoder::interleave_plane_dither_t pf_interleave_dither;
+  // log2 of the vvc-output-scale divisor: the decoded planes are downscaled into the picture
+  int outputScale;
+  VvcDecoder::downscale_plane_t pf_downscale;
+  // helper threads copying the output pictures in horizontal bands
+  VvcDecoder::BandPool copyPool;
+  // cpus and NUMA node of the decoder threads, the VLC decoder thread is bound on its first block
+  VvcDecoder::ThreadPlacement placement;
+  bool b_placement_pending;
+  // libvtmdec instance kept idle at close for a next stream with the same settings
+  VvcDecoder::instance_key_t instanceKey;
+  int maxIdleInstances;
+  // share of the thread budget shared by the decoders, inactive if not taking part
+  VvcDecoder::ThreadShare threadShare;
+  // threads of the VTM pool, restricted to the cpus of the share, and to fewer
+  // cpus while decoding is well ahead with thread scaling
+  static const int THREAD_SHRINK_DELAY = 50;
+  VvcDecoder::ThreadGroup vtmThreads;
+  bool b_threadScaling;
+  int threadScaling_delai_shrink;
+
+  /*
+   * Asynchronous output stage
+   */
+  struct output_request
+  {
+    mtime_t i_dts;
+    bool b_drain;
+    bool b_quit;
+  };
+  static const size_t OUTPUT_QUEUE_SIZE = 64;
+  bool b_async_output;
+  vlc_thread_t output_thread;
+  vlc_mutex_t vtm_lock;     // protects decVtm and the decoding state shared with the output thread, never held in vout calls
+  vlc_sem_t output_pending;
+  vlc_sem_t output_free;
+  vlc_sem_t output_drained;
+  VvcDecoder::SpscQueue<output_request, OUTPUT_QUEUE_SIZE> output_queue;
+
+  /*
+   * Statistics, published every stats_interval
+   */
+  VvcDecoder::Histogram stat_decode;    // duration of decVTM_decode calls (us)
+  VvcDecoder::Histogram stat_copy;      // duration of FillPicture (us)
+  VvcDecoder::Histogram stat_lateness;  // output lateness (us)
+  VvcDecoder::Histogram stat_queue;     // pictures inside the decoder at output
+  VvcDecoder::Histogram stat_speedUp;   // speedUpLevel at output
+  mtime_t stats_interval;
+  mtime_t stats_last;
 };
 
 /****************************************************************************
@@ -101,14 +216,25 @@ static int  OpenDecoder(vlc_object_t*);
 static void CloseDec(vlc_object_t*);
 static int DecodeFrame(decoder_t* p_dec, block_t* p_block);
 static void FillPicture(decoder_t* p_dec, picture_t* p_pic, int posx, int posy,
-  int picWidth, int picHeight, short* planes[3], int strides[3]);
+  int picWidth, int picHeight, int bitDepth, short* planes[3], int strides[3], bool b_fillBelow = true, int scale = 0);
+static void CopyPicture(decoder_t* p_dec, picture_t* p_pic, int posx, int posy,
+  int picWidth, int picHeight, int bitDepth, int chromaFormat, short* planes[3], int strides[3]);
 static void Flush(decoder_t* p_dec);
 static bool getOutputFrame(decoder_t* p_dec, bool waitUntilReady, mtime_t i_dts);
+static void* OutputThread(void* p_data);
+static void PushOutputRequest(decoder_sys_t* p_sys, mtime_t i_dts, bool b_drain, bool b_quit);
+static void publishStats(decoder_t* p_dec, decoder_sys_t* p_sys);
+static int updateVideoFormat(decoder_t* p_dec, decoder_sys_t* p_sys);
+static bool colourDescriptionChanged(decoder_sys_t* p_sys);
+static void resetDecodingState(decoder_sys_t* p_sys);
+static void drainDecoder(decoder_t* p_dec);
+static void updateActiveThreads(decoder_t* p_dec, decoder_sys_t* p_sys);
 static int initVideoFormat(decoder_t* p_dec, decoder_sys_t* p_sys,
   vlc_fourcc_t videoFormat = VLC_CODEC_I420_10L,
   unsigned int frame_width = 0, unsigned int frame_height = 0);
 static int initVideoFrameRate(decoder_t* p_dec, decoder_sys_t* p_sys,
   unsigned int i_frame_rate = 0, unsigned int i_frame_rate_base = 0);
+static void detectFrameRate(decoder_t* p_dec, decoder_sys_t* p_sys, mtime_t i_dts);
 
 namespace VvcDecoder
 {
@@ -121,6 +247,21 @@ namespace VvcDecoder
   block_t* PacketizeVVC(decoder_t* p_dec, block_t** pp_block);
 }
 
+static const char* const ppsz_copy_impl_values[] = { "auto", "c", "sse4.1", "avx2" };
+static const int pi_output_depth_values[] = { 0, 8 };
+static const char* const ppsz_output_depth_descriptions[] = { N_("Stream"), N_("8 bits") };
+static const int pi_output_scale_values[] = { 1, 2, 4 };
+static const char* const ppsz_output_scale_descriptions[] = { N_("Full size"), N_("1/2"), N_("1/4") };
+static const char* const ppsz_stats_vars[] = {
+  "vvc-stats-decode-p50", "vvc-stats-decode-p99",
+  "vvc-stats-copy-p50", "vvc-stats-copy-p99",
+  "vvc-stats-lateness-p50", "vvc-stats-lateness-p99",
+  "vvc-stats-queue-p50", "vvc-stats-queue-p99",
+  "vvc-stats-speedup-max",
+  "vvc-stats-format-updates",
+  "vvc-stats-seek-latency",
+};
+
 /*****************************************************************************
  * Module descriptor
  *****************************************************************************/
@@ -131,11 +272,35 @@ set_capability("video decoder", 50)
 set_category(CAT_INPUT)
 set_subcategory(SUBCAT_INPUT_VCODEC)
 set_callbacks(OpenDecoder, CloseDec)
-add_integer("nb-threads", 0, N_("Number of threads for decoding"), N_("number of threads for decoding in the range [1-32]; 0: automatic detection of cores "), false)
+// idle libvtmdec instances (vvc-instance-cache) keep their threads running past the close
+cannot_unload_broken_library()
+add_integer("nb-threads", 0, N_("Number of threads for decoding"), N_("number of threads for decoding in the range [1-32]; 0: automatic detection of physical cores (within the cpu affinity and cgroup cpu quota on Linux)"), false)
+add_bool("vvc-thread-budget", true, N_("Share the cores between decoders"), N_("with automatic thread count, split the cores between the decoders running at the same time, in proportion of their picture size"), true)
+add_bool("vvc-thread-scaling", false, N_("Scale the active threads"), N_("run the decoder threads on fewer cpus while decoding is well ahead of the display, and on all of them again when it gets close to late (Linux only); this frees cpus for other work, the threads still run, or spin, on the cpus they keep"), true)
 add_integer("nb-threads-parsing", -1, N_("Maximum number of threads for CABAC parsing"), N_("Maximum number of threads for CABAC parsing (from same pool as decoding threads) [1-32]; -1: auto; 0: sequantial parsing and decoding"), false)
 add_integer("target-layer-set", -1, N_("Target output layer set"), N_("Target output layer set (for multi-layer streams)"), false)
 add_bool("vvc-enable-hurry-mode", true, N_("Enable hurry-up mode"), N_("hurry-up mode: skip decoding pictures if late"), false)
+add_integer("vvc-decode-level", 0, N_("Decode level"), N_("libvtmdec speed-up level used for every picture: 0 decodes at full quality, higher levels let libvtmdec trade quality for speed"), true)
+change_integer_range(0, decoder_sys_t::MAX_SPEED_UP_LEVEL)
+add_integer("vvc-max-decode-level", decoder_sys_t::MAX_SPEED_UP_LEVEL, N_("Maximum decode level"), N_("highest libvtmdec speed-up level used by hurry-up mode when decoding is late"), true)
+change_integer_range(0, decoder_sys_t::MAX_SPEED_UP_LEVEL)
+add_integer("vvc-stats-interval", 10, N_("Statistics interval"), N_("interval in seconds between decoding statistics reports (debug messages and vvc-stats-* variables); 0: disabled"), true)
+add_bool("vvc-async-output", false, N_("Asynchronous output"), N_("copy and queue output pictures from a dedicated thread, in parallel with decoding"), true)
+add_string("vvc-cpu-set", "", N_("Decoder cpus"), N_("cpus used by the decoder threads, as a cpulist: 0-7,16-23; empty: all (Linux only)"), true)
+add_integer("vvc-numa-node", -1, N_("Decoder NUMA node"), N_("NUMA node of the decoder threads and of their memory; -1: any (Linux only)"), true)
+add_integer("vvc-instance-cache", 0, N_("Idle decoder instances"), N_("number of decoder instances kept idle after a stream, reused by the next streams with the same settings to start faster; each one keeps its threads and memory; 0: disabled"), true)
+add_bool("vvc-low-delay", false, N_("Low-delay output"), N_("output the pictures of streams without reordering with the timestamp of their access unit, instead of one delayed by the decoder latency"), true)
+add_bool("vvc-thumbnail", false, N_("Thumbnail mode"), N_("decode the first IDR or CRA picture after the start or seek time on a single thread, output it and skip the rest of the stream"), true)
+add_integer("vvc-max-picture-buffers", 32, N_("Maximum extra output pictures"), N_("maximum number of extra output pictures allocated for the decoder; fewer are allocated if the stream reorders fewer pictures (reorder pictures + 2), taken into account when the video output is created or recreated"), true)
 add_string("vvc-opt", "", N_("other decoder options"), N_("generic decoder option: --option1=value1 --option2=value2 ... --optionN=valueN"), false)
+add_string("vvc-copy-impl", "auto", N_("Output copy implementation"), N_("implementation of the 8-bit output copy: auto, c, sse4.1, avx2"), true)
+change_string_list(ppsz_copy_impl_values, ppsz_copy_impl_values)
+add_integer("vvc-copy-threads", 1, N_("Output copy threads"), N_("number of threads copying each output picture, in horizontal bands, to shorten the time between the end of its decoding and its display; 1: the output thread alone"), true)
+add_bool("vvc-semiplanar", false, N_("Semi-planar output"), N_("output 4:2:0 8-bit and 10-bit pictures as NV12/P010 instead of I420/I420_10L"), true)
+add_integer("vvc-output-depth", 0, N_("Output bit depth"), N_("bit depth of the output pictures: 0: stream bit depth; 8: 10-bit and 12-bit streams are dithered to 8 bits"), true)
+change_integer_list(pi_output_depth_values, ppsz_output_depth_descriptions)
+add_integer("vvc-output-scale", 1, N_("Output scale"), N_("divides the width and height of the output pictures: 1, 2 or 4; the decoded pictures are box-filtered in the output copy"), true)
+change_integer_list(pi_output_scale_values, ppsz_output_scale_descriptions)
 
 add_submodule()
 set_description(N_("VVC binary demuxer"))
@@ -151,6 +316,7 @@ set_subcategory(SUBCAT_SOUT_PACKETIZER)
 set_description(N_("VVC/H.266 video packetizer"))
 set_capability("packetizer", 50)
 set_callbacks(VvcDecoder::OpenPack, VvcDecoder::ClosePack)
+add_float("vvc-trickplay-rate", 4, N_("IRAP-only playback rate"), N_("from this playback rate (fast forward), only the IRAP access units are passed to the decoder; 0: disabled"), true)
 
 vlc_module_end()
 
@@ -166,6 +332,22 @@ static int OpenDecoder(vlc_object_t * p_this)
   if (unlikely(p_sys == NULL))
     return VLC_ENOMEM;
 
+  char* psz_cpuSet = var_CreateGetString(p_dec, "vvc-cpu-set");
+  const int numaNode = (int)var_CreateGetInteger(p_dec, "vvc-numa-node");
+  if (!p_sys->placement.init(psz_cpuSet, numaNode))
+  {
+    msg_Warn(p_dec, "cannot place decoder threads on cpus \"%s\" / numa node %d, ignored", psz_cpuSet ? psz_cpuSet : "", numaNode);
+  }
+  else if (p_sys->placement.isActive())
+  {
+    msg_Info(p_dec, "decoder threads placed on %d cpus (numa node %d)", p_sys->placement.cpuCount(), numaNode);
+  }
+  p_sys->instanceKey.placement = std::string(psz_cpuSet ? psz_cpuSet : "") + "/" + std::to_string(numaNode);
+  free(psz_cpuSet);
+  p_sys->b_placement_pending = p_sys->placement.isActive();
+  p_sys->b_thumbnail = var_CreateGetBool(p_dec, "vvc-thumbnail");
+  p_sys->b_thumbnail_done = false;
+
   ////////////
   char psz_threadsvar[30];
   int nbThreads = 0, nbThreadsForParsing = -1;
@@ -174,6 +356,15 @@ static int OpenDecoder(vlc_object_t * p_this)
     nbThreads = std::max(nbThreads, (int)var_CreateGetInteger(p_dec, psz_threadsvar));
   }
 
+  if (p_sys->b_thumbnail)
+  {
+    // a single picture: starting a thread pool would cost more than it saves
+    nbThreads = 1;
+    nbThreadsForParsing = 1;
+  }
+
+  // idle instances are looked up with the thread count asked for, not the share
+  p_sys->instanceKey.nbThreads = nbThreads;
   if(nbThreads <= 0)
   {
 #if _WIN32
@@ -201,12 +392,32 @@ static int OpenDecoder(vlc_object_t * p_this)
     }
 
 #else
-    const auto processor_count = std::thread::hardware_concurrency();
+    int processor_count = (int)std::thread::hardware_concurrency();
+    VvcDecoder::cpu_info_t cpuInfo;
+    if (VvcDecoder::GetCpuInfo(p_sys->placement.isActive() ? &p_sys->placement.cpus() : NULL, &cpuInfo))
+    {
+      // SMT siblings bring little to VTM, and threads above the cgroup quota get throttled
+      processor_count = cpuInfo.physicalCores;
+      if (cpuInfo.quotaCpus > 0)
+        processor_count = std::min(processor_count, cpuInfo.quotaCpus);
+      msg_Dbg(p_dec, "%d usable cpus, %d physical cores, cpu quota %d", cpuInfo.logicalCpus, cpuInfo.physicalCores, cpuInfo.quotaCpus);
+    }
 #endif
     msg_Info(p_dec, "found %d cores", processor_count);
     nbThreads = std::max(1, (int)processor_count);
+    p_sys->instanceKey.nbThreads = nbThreads;
+    // decoders placed on their own cpus are not competing for the same cores
+    if (!p_sys->placement.isActive() && var_CreateGetBool(p_dec, "vvc-thread-budget"))
+    {
+      // the picture size is not always known before the SPS: count it as 1080p then
+      const unsigned int width = p_dec->fmt_in.video.i_width ? p_dec->fmt_in.video.i_width : 1920;
+      const unsigned int height = p_dec->fmt_in.video.i_height ? p_dec->fmt_in.video.i_height : 1080;
+      int nbDecoders;
+      nbThreads = p_sys->threadShare.acquire(nbThreads, (uint64_t)width * height, &nbDecoders);
+      msg_Info(p_dec, "use %d threads, %d decoders sharing the cores", nbThreads, nbDecoders);
+    }
   }
-  if (sprintf(psz_threadsvar, "nb-threads-parsing"))
+  if (!p_sys->b_thumbnail && sprintf(psz_threadsvar, "nb-threads-parsing"))
   {
     nbThreadsForParsing = std::max(nbThreadsForParsing, (int)var_CreateGetInteger(p_dec, psz_threadsvar));
   }
@@ -220,9 +431,14 @@ static int OpenDecoder(vlc_object_t * p_this)
   p_sys->enable_hurryMode = true;
   if (sprintf(psz_hurryvar, "vvc-enable-hurry-mode"))
   {
-    p_sys->enable_hurryMode = var_CreateGetBool(p_dec, psz_hurryvar);
+    p_sys->enable_hurryMode = var_CreateGetBool(p_dec, psz_hurryvar) && !p_sys->b_thumbnail;
   }
 
+  p_sys->minSpeedUpLevel = std::min(std::max((int)var_CreateGetInteger(p_dec, "vvc-decode-level"), 0), (int)decoder_sys_t::MAX_SPEED_UP_LEVEL);
+  p_sys->maxSpeedUpLevel = std::min(std::max((int)var_CreateGetInteger(p_dec, "vvc-max-decode-level"), p_sys->minSpeedUpLevel), (int)decoder_sys_t::MAX_SPEED_UP_LEVEL);
+  if (p_sys->minSpeedUpLevel > 0 || p_sys->maxSpeedUpLevel < decoder_sys_t::MAX_SPEED_UP_LEVEL)
+    msg_Dbg(p_dec, "decode levels %d to %d", p_sys->minSpeedUpLevel, p_sys->maxSpeedUpLevel);
+
   char psz_targetLayer[30];
   int targetLayerSet = -1;
   if (sprintf(psz_targetLayer, "target-layer-set"))
@@ -230,6 +446,51 @@ static int OpenDecoder(vlc_object_t * p_this)
     targetLayerSet = (int)var_CreateGetInteger(p_dec, psz_targetLayer);
   }
 
+  VvcDecoder::copy_impl_e copyImpl = VvcDecoder::GetCopyImpl();
+  char* psz_copyImpl = var_CreateGetString(p_dec, "vvc-copy-impl");
+  if (psz_copyImpl)
+  {
+    // a forced implementation is only used if the cpu supports it
+    if (!strcmp(psz_copyImpl, "c"))
+      copyImpl = VvcDecoder::COPY_IMPL_C;
+    else if (!strcmp(psz_copyImpl, "sse4.1") && copyImpl >= VvcDecoder::COPY_IMPL_SSE4_1)
+      copyImpl = VvcDecoder::COPY_IMPL_SSE4_1;
+    free(psz_copyImpl);
+  }
+  p_sys->pf_copy_narrow = VvcDecoder::GetCopyPlaneNarrow(copyImpl);
+  p_sys->pf_copy = VvcDecoder::GetCopyPlane(copyImpl);
+  p_sys->pf_copy_shift = VvcDecoder::GetCopyPlaneShift(copyImpl);
+  p_sys->pf_interleave_narrow = VvcDecoder::GetInterleavePlaneNarrow(copyImpl);
+  p_sys->pf_interleave = VvcDecoder::GetInterleavePlane(copyImpl);
+  p_sys->b_semiplanar = var_CreateGetBool(p_dec, "vvc-semiplanar");
+  p_sys->pf_copy_dither = VvcDecoder::GetCopyPlaneDither(copyImpl);
+  p_sys->pf_interleave_dither = VvcDecoder::GetInterleavePlaneDither(copyImpl);
+  p_sys->outputDepth = (int)var_CreateGetInteger(p_dec, "vvc-output-depth");
+  if (p_sys->outputDepth != 0 && p_sys->outputDepth != 8)
+  {
+    msg_Warn(p_dec, "unsupported output bit depth %d, using the stream bit depth", p_sys->outputDepth);
+    p_sys->outputDepth = 0;
+  }
+  p_sys->pf_downscale = VvcDecoder::GetDownscalePlane(copyImpl);
+  const int outputScale = (int)var_CreateGetInteger(p_dec, "vvc-output-scale");
+  switch (outputScale)
+  {
+  case 1:
+    p_sys->outputScale = 0;
+    break;
+  case 2:
+    p_sys->outputScale = 1;
+    break;
+  case 4:
+    p_sys->outputScale = 2;
+    break;
+  default:
+    msg_Warn(p_dec, "unsupported output scale 1/%d, using full size", outputScale);
+    p_sys->outputScale = 0;
+    break;
+  }
+  msg_Dbg(p_dec, "using %s output copy", VvcDecoder::GetCopyImplName(copyImpl));
+
   char psz_vvcOpt[30];
   char *opt;
   if (sprintf(psz_vvcOpt, "vvc-opt"))
@@ -237,7 +498,7 @@ static int OpenDecoder(vlc_object_t * p_this)
     opt = var_CreateGetString(p_dec, psz_vvcOpt);
   }
 
-#ifdef WIN32
+#if defined(WIN32) && !defined(VTMDEC_MOCK)
   SetDefaultDllDirectories(LOAD_LIBRARY_SEARCH_DEFAULT_DIRS);
   char* baseName = strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : (strrchr(__FILE__, '\\') ? strrchr(__FILE__, '\\') + 1 : __FILE__);
   HMODULE loadLibRes = LoadLibrary(VTM_LIB_NAME);
@@ -292,9 +553,50 @@ static int OpenDecoder(vlc_object_t * p_this)
 #endif
 
   msg_Info(p_dec, "using decoder with cfg --nbThreads=%d --nbThreadsForParsing=%d %s", nbThreads, nbThreadsForParsing, opt);
-  // create & initialize internal classes
-  if (!(p_sys->decVtm = decVTM_create(nbThreads, nbThreadsForParsing, targetLayerSet, opt)))
+  p_sys->instanceKey.nbThreadsForParsing = nbThreadsForParsing;
+  p_sys->instanceKey.targetLayerSet = targetLayerSet;
+  p_sys->instanceKey.opt = opt ? opt : "";
+  p_sys->maxIdleInstances = std::max(0, (int)var_CreateGetInteger(p_dec, "vvc-instance-cache"));
+  p_sys->decVtm = p_sys->maxIdleInstances > 0 ? VvcDecoder::AcquireInstance(p_sys->instanceKey, &p_sys->vtmThreads) : NULL;
+  const bool b_reused = p_sys->decVtm != NULL;
+  p_sys->b_threadScaling = var_CreateGetBool(p_dec, "vvc-thread-scaling") && !p_sys->b_thumbnail;
+  if (b_reused)
   {
+    msg_Dbg(p_dec, "reusing an idle decoder instance");
+  }
+  else
+  {
+    // the threads are needed to follow the share when other decoders come and go,
+    // and by the decoders that may reuse the instance once idle
+    const bool b_findThreads = p_sys->b_threadScaling || p_sys->threadShare.isActive() || p_sys->maxIdleInstances > 0;
+    // create & initialize internal classes, the VTM threads inherit the placement
+    p_sys->placement.bind();
+    if (b_findThreads)
+      p_sys->vtmThreads.begin();
+    p_sys->decVtm = decVTM_create(nbThreads, nbThreadsForParsing, targetLayerSet, opt);
+    if (b_findThreads)
+      p_sys->vtmThreads.end();
+    p_sys->placement.unbind();
+  }
+  // a reused instance has the threads found when it was created, if any
+  if (p_sys->decVtm && p_sys->b_threadScaling && p_sys->vtmThreads.isEmpty())
+    msg_Warn(p_dec, "cannot find the decoder threads, thread scaling disabled");
+  if (!p_sys->vtmThreads.isEmpty() && p_sys->threadShare.isActive())
+  {
+    p_sys->threadShare.setResizable(std::min(p_sys->vtmThreads.cpuCount(), p_sys->instanceKey.nbThreads));
+    // alone, the decoder keeps all its cpus until another one opens
+    if (p_sys->threadShare.isShared())
+      p_sys->vtmThreads.restrict(p_sys->threadShare.threads());
+  }
+  p_sys->threadScaling_delai_shrink = decoder_sys_t::THREAD_SHRINK_DELAY;
+  if (!p_sys->vtmThreads.isEmpty())
+  {
+    var_Create(p_dec, "vvc-active-threads", VLC_VAR_INTEGER);
+    var_SetInteger(p_dec, "vvc-active-threads", p_sys->vtmThreads.activeCount());
+  }
+  if (!p_sys->decVtm)
+  {
+    p_sys->threadShare.release();
     return VLC_EGENERIC;
   }
 
@@ -309,11 +611,30 @@ static int OpenDecoder(vlc_object_t * p_this)
   p_sys->b_frameRateDetect = false;
   p_sys->dec_frame_count = 0;
   p_sys->out_frame_count = 0;
-  p_sys->speedUpLevel = 0;
+  p_sys->drop_frame_count = 0;
+  p_sys->layoutWidth = 0;
+  p_sys->layoutHeight = 0;
+  p_sys->b_vout_ready = false;
+  p_sys->format_update_count = 0;
+  p_sys->p_pic = NULL;
+  p_sys->b_pic_copy = false;
+  p_sys->p_spare = NULL;
+  p_sys->speedUpLevel = p_sys->minSpeedUpLevel;
   p_sys->speedUpLevel_delai_increase = 0;
   p_sys->speedUpLevel_delai_decrease = 0;
   p_sys->speedUpLevel_previous_lateness = 0;
   p_sys->speedUpLevel_delai_derivative = 0;
+  p_sys->maxTid = 0;
+  p_sys->dropTid = decoder_sys_t::MAX_TEMPORAL_ID + 1;
+  p_sys->nbDroppedPictures = 0;
+  p_sys->b_discard_output = false;
+  // a reused instance was drained like on a flush: resume at an IRAP as well
+  p_sys->b_wait_irap = b_reused;
+  p_sys->b_skip_rasl = false;
+  p_sys->preroll_end = VLC_TS_INVALID;
+  p_sys->preroll_frame_count = 0;
+  p_sys->flush_time = VLC_TS_INVALID;
+  p_sys->seekLatency = 0;
 
   /////////////////////////////
 
@@ -324,7 +645,53 @@ static int OpenDecoder(vlc_object_t * p_this)
   p_dec->p_sys = p_sys;
   p_dec->pf_decode = DecodeFrame;
   p_dec->pf_flush = Flush;
-  p_dec->i_extra_picture_buffers = 32;
+  p_sys->maxExtraPictureBuffers = p_sys->b_thumbnail ? 1 : std::max(1, (int)var_CreateGetInteger(p_dec, "vvc-max-picture-buffers"));
+  p_dec->i_extra_picture_buffers = p_sys->maxExtraPictureBuffers;
+  p_sys->b_low_delay_mode = var_CreateGetBool(p_dec, "vvc-low-delay");
+  p_sys->b_low_delay = false;
+  p_sys->b_reorderedPts = true;
+  // the thumbnail picture takes the timestamp of its access unit
+  p_sys->b_irap_only = p_sys->b_thumbnail;
+
+  p_sys->stats_interval = CLOCK_FREQ * std::max(0, (int)var_CreateGetInteger(p_dec, "vvc-stats-interval"));
+  p_sys->stats_last = mdate();
+  if (p_sys->stats_interval > 0)
+  {
+    for (const char* psz_var : ppsz_stats_vars)
+    {
+      var_Create(p_dec, psz_var, VLC_VAR_INTEGER);
+    }
+  }
+
+  const int nbCopyThreads = std::max(1, (int)var_CreateGetInteger(p_dec, "vvc-copy-threads"));
+  if (nbCopyThreads > 1)
+  {
+    p_sys->placement.bind();
+    if (!p_sys->copyPool.start(nbCopyThreads - 1))
+      msg_Warn(p_dec, "could not start the output copy threads");
+    p_sys->placement.unbind();
+    msg_Dbg(p_dec, "output copy on %d threads", p_sys->copyPool.threadCount());
+  }
+
+  vlc_mutex_init(&p_sys->vtm_lock);
+  p_sys->b_async_output = var_CreateGetBool(p_dec, "vvc-async-output");
+  if (p_sys->b_async_output)
+  {
+    vlc_sem_init(&p_sys->output_pending, 0);
+    vlc_sem_init(&p_sys->output_free, decoder_sys_t::OUTPUT_QUEUE_SIZE);
+    vlc_sem_init(&p_sys->output_drained, 0);
+    p_sys->placement.bind();
+    const int i_ret = vlc_clone(&p_sys->output_thread, OutputThread, p_dec, VLC_THREAD_PRIORITY_VIDEO);
+    p_sys->placement.unbind();
+    if (i_ret)
+    {
+      msg_Warn(p_dec, "could not start output thread, using synchronous output");
+      vlc_sem_destroy(&p_sys->output_pending);
+      vlc_sem_destroy(&p_sys->output_free);
+      vlc_sem_destroy(&p_sys->output_drained);
+      p_sys->b_async_output = false;
+    }
+  }
 
   return VLC_SUCCESS;
 }
@@ -355,7 +722,11 @@ static int initVideoFormat(decoder_t* p_dec, decoder_sys_t* p_sys,
   p_dec->fmt_out.video.transfer = p_dec->fmt_in.video.transfer;
   p_dec->fmt_out.video.space = p_dec->fmt_in.video.space;
   unsigned int primaries = 0, transfer = 0, matrix = -1, full_range_flag = -1, maxCLL = 0, maxFALL = 0;
-  if (decVTM_getColourDescriptionInfo(p_sys->decVtm, &primaries, &transfer, &matrix, &full_range_flag, &maxCLL, &maxFALL))
+  const bool b_colourDesc = decVTM_getColourDescriptionInfo(p_sys->decVtm, &primaries, &transfer, &matrix, &full_range_flag, &maxCLL, &maxFALL);
+  const unsigned int colourDesc[] = { primaries, transfer, matrix, full_range_flag, maxCLL, maxFALL };
+  static_assert(sizeof(colourDesc) == sizeof(p_sys->colourDesc), "same colour description");
+  memcpy(p_sys->colourDesc, colourDesc, sizeof(colourDesc));
+  if (b_colourDesc)
   {
     switch (primaries)
     {
@@ -494,8 +865,8 @@ static int initVideoFrameRate(decoder_t* p_dec, decoder_sys_t* p_sys,
         p_dec->fmt_out.video.i_frame_rate_base);
       date_Init(&p_sys->pts, 50, 1);
       p_sys->b_frameRateDetect = true;
-      p_sys->dts1 = VLC_TS_INVALID;
-      p_sys->dts2 = VLC_TS_INVALID;
+      p_sys->lastDetect_dts = VLC_TS_INVALID;
+      p_sys->dtsDeltas.clear();
     }
     else
       date_Init(&p_sys->pts, p_dec->fmt_out.video.i_frame_rate,
@@ -504,6 +875,76 @@ static int initVideoFrameRate(decoder_t* p_dec, decoder_sys_t* p_sys,
   return VLC_SUCCESS;
 }
 
+/*****************************************************************************
+ * detectFrameRate: estimates the frame rate from a window of dts deltas
+ *****************************************************************************/
+static void detectFrameRate(decoder_t* p_dec, decoder_sys_t* p_sys, mtime_t i_dts)
+{
+  static const struct
+  {
+    unsigned int num;
+    unsigned int den;
+  } standardRates[] = {
+    { 24000, 1001 }, { 24, 1 }, { 25, 1 }, { 30000, 1001 }, { 30, 1 },
+    { 48, 1 }, { 50, 1 }, { 60000, 1001 }, { 60, 1 }, { 100, 1 },
+    { 120000, 1001 }, { 120, 1 },
+  };
+
+  const mtime_t lastDts = p_sys->lastDetect_dts;
+  p_sys->lastDetect_dts = i_dts;
+  if (lastDts == VLC_TS_INVALID || i_dts <= lastDts)
+  {
+    return;
+  }
+  p_sys->dtsDeltas.push_back(i_dts - lastDts);
+  if (p_sys->dtsDeltas.size() > decoder_sys_t::FPS_DETECT_WINDOW)
+  {
+    p_sys->dtsDeltas.erase(p_sys->dtsDeltas.begin());
+  }
+  if (p_sys->dtsDeltas.size() < decoder_sys_t::FPS_DETECT_MIN_DELTAS)
+  {
+    return;
+  }
+
+  // median is robust to jitter (90kHz rounding, muxer) and to missing frames
+  std::vector<mtime_t> sorted = p_sys->dtsDeltas;
+  std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+  const mtime_t median = sorted[sorted.size() / 2];
+  const mtime_t tolerance = std::max<mtime_t>(median / 50, 2);
+  size_t nbInliers = 0;
+  for (mtime_t delta : p_sys->dtsDeltas)
+  {
+    if (std::abs(delta - median) <= tolerance)
+      nbInliers++;
+  }
+  const unsigned int confidence = (unsigned int)(100 * nbInliers / p_sys->dtsDeltas.size());
+  if (confidence < 75 && p_sys->dtsDeltas.size() < decoder_sys_t::FPS_DETECT_WINDOW)
+  {
+    return;
+  }
+
+  unsigned int i_frame_rate = (unsigned int)(CLOCK_FREQ * 1000 / median);
+  unsigned int i_frame_rate_base = 1000;
+  mtime_t bestError = tolerance + 1;
+  for (const auto& rate : standardRates)
+  {
+    const mtime_t period = CLOCK_FREQ * rate.den / rate.num;
+    if (std::abs(period - median) < bestError)
+    {
+      bestError = std::abs(period - median);
+      i_frame_rate = rate.num;
+      i_frame_rate_base = rate.den;
+    }
+  }
+
+  p_sys->b_frameRateDetect = false;
+  p_sys->dtsDeltas.clear();
+  initVideoFrameRate(p_dec, p_sys, i_frame_rate, i_frame_rate_base);
+  msg_Info(p_dec, "detected frame rate %d/%d, from timestamps (confidence %d%%)",
+    p_dec->fmt_out.video.i_frame_rate,
+    p_dec->fmt_out.video.i_frame_rate_base, confidence);
+}
+
 /*****************************************************************************
  * Flush:
  *****************************************************************************/
@@ -511,10 +952,149 @@ static void Flush(decoder_t* p_dec)
 {
   decoder_sys_t* p_sys = p_dec->p_sys;
 
-  msg_Warn(p_dec, "decoder flush called at pts: %d ", date_Get(&p_sys->pts));
-  //date_Set(&p_sys->pts, VLC_TS_INVALID);
- 
-  //getOutputFrame(p_dec, nullptr);
+  msg_Dbg(p_dec, "decoder flush called at pts: %lld", (long long)date_Get(&p_sys->pts));
+  // libvtmdec cannot reset: the pictures still in the decoder are output and discarded
+  vlc_mutex_lock(&p_sys->vtm_lock);
+  p_sys->b_discard_output = true;
+  decVTM_decode(p_sys->decVtm, nullptr, 0, p_sys->speedUpLevel);
+  decVTM_flush(p_sys->decVtm);
+  vlc_mutex_unlock(&p_sys->vtm_lock);
+  if (p_sys->b_async_output)
+  {
+    PushOutputRequest(p_sys, VLC_TS_INVALID, true, false);
+    vlc_sem_wait(&p_sys->output_drained);
+  }
+  else
+    while (getOutputFrame(p_dec, true, VLC_TS_INVALID));
+
+  vlc_mutex_lock(&p_sys->vtm_lock);
+  p_sys->b_discard_output = false;
+  // a picture waiting for its next layers
+  if (p_sys->p_pic)
+  {
+    picture_Release(p_sys->p_pic);
+    p_sys->p_pic = NULL;
+  }
+  resetDecodingState(p_sys);
+  date_Set(&p_sys->pts, VLC_TS_INVALID);
+  p_sys->b_wait_irap = true;
+  p_sys->preroll_end = VLC_TS_INVALID;
+  p_sys->flush_time = mdate();
+  // after a seek: a new thumbnail at the new position
+  p_sys->b_thumbnail_done = false;
+  vlc_mutex_unlock(&p_sys->vtm_lock);
+}
+
+/*****************************************************************************
+ * updateActiveThreads: as many cpus for the VTM threads as the thread budget
+ * leaves to the decoder; with thread scaling, fewer while the output is well
+ * ahead of the display, twice as many as soon as it gets close to late
+ *****************************************************************************/
+static void updateActiveThreads(decoder_t* p_dec, decoder_sys_t* p_sys)
+{
+  const mtime_t period = CLOCK_FREQ * p_sys->pts.i_divider_den / p_sys->pts.i_divider_num;
+  const mtime_t lateness = p_sys->lastOutput_time - p_sys->lastOutput_pts;
+  const int active = p_sys->vtmThreads.activeCount();
+  // the share changes when other decoders open or close
+  int limit = p_sys->vtmThreads.cpuCount();
+  if (p_sys->threadShare.isShared())
+    limit = std::min(limit, p_sys->threadShare.threads());
+  int target = active;
+  if (!p_sys->b_threadScaling)
+  {
+    target = limit;
+  }
+  else if (lateness > -period / 2)
+  {
+    target = std::min(limit, 2 * active);
+    p_sys->threadScaling_delai_shrink = decoder_sys_t::THREAD_SHRINK_DELAY;
+  }
+  else if (lateness < -2 * period)
+  {
+    // only shrink after being ahead for a while
+    if (p_sys->threadScaling_delai_shrink-- <= 0)
+    {
+      target = std::max(1, active - 1);
+      p_sys->threadScaling_delai_shrink = decoder_sys_t::THREAD_SHRINK_DELAY;
+    }
+  }
+  else
+  {
+    p_sys->threadScaling_delai_shrink = decoder_sys_t::THREAD_SHRINK_DELAY;
+  }
+
+  target = std::min(target, limit);
+  if (target != active)
+  {
+    p_sys->vtmThreads.restrict(target);
+    msg_Info(p_dec, "decoder threads on %d of %d cpus (lateness %d us)", target, p_sys->vtmThreads.cpuCount(), (int)lateness);
+    var_SetInteger(p_dec, "vvc-active-threads", target);
+  }
+}
+
+/*****************************************************************************
+ * drainDecoder: outputs the pictures left in the decoder, then starts over
+ *****************************************************************************/
+static void drainDecoder(decoder_t* p_dec)
+{
+  decoder_sys_t* p_sys = p_dec->p_sys;
+  vlc_mutex_lock(&p_sys->vtm_lock);
+  decVTM_flush(p_sys->decVtm);
+  vlc_mutex_unlock(&p_sys->vtm_lock);
+  if (p_sys->b_async_output)
+  {
+    PushOutputRequest(p_sys, VLC_TS_INVALID, true, false);
+    vlc_sem_wait(&p_sys->output_drained);
+  }
+  else
+    while (getOutputFrame(p_dec, true, VLC_TS_INVALID));
+
+  vlc_mutex_lock(&p_sys->vtm_lock);
+  resetDecodingState(p_sys);
+  vlc_mutex_unlock(&p_sys->vtm_lock);
+}
+
+/*****************************************************************************
+ * switchToReorderedPts: the pictures still in the decoder keep the timestamps
+ * they had in decoding order
+ *****************************************************************************/
+static void switchToReorderedPts(decoder_sys_t* p_sys)
+{
+  p_sys->reorderedPts.clear();
+  for (mtime_t pts : p_sys->pendingPts)
+  {
+    if (pts > VLC_TS_INVALID)
+      p_sys->reorderedPts.insert(pts);
+    else
+      p_sys->b_reorderedPts = false;
+  }
+  if (!p_sys->b_reorderedPts)
+    p_sys->reorderedPts.clear();
+  p_sys->pendingPts.clear();
+}
+
+static void resetDecodingState(decoder_sys_t* p_sys)
+{
+  p_sys->pendingPts.clear();
+  p_sys->reorderedPts.clear();
+  p_sys->b_reorderedPts = true;
+  p_sys->b_first_frame = true;
+  p_sys->lastOutput_pts = VLC_TS_INVALID;
+  p_sys->firstOutput_pts = VLC_TS_INVALID;
+  p_sys->firstOutput_time = VLC_TS_INVALID;
+  p_sys->lastOutput_time = VLC_TS_INVALID;
+  p_sys->firstBlock_dts = VLC_TS_INVALID;
+  p_sys->firstBlock = true;
+  p_sys->b_format_init = true;
+  p_sys->b_frameRateDetect = false;
+  p_sys->speedUpLevel = p_sys->minSpeedUpLevel;
+  p_sys->speedUpLevel_delai_increase = 0;
+  p_sys->speedUpLevel_delai_decrease = 0;
+  p_sys->speedUpLevel_previous_lateness = 0;
+  p_sys->speedUpLevel_delai_derivative = 0;
+  p_sys->maxTid = 0;
+  p_sys->dropTid = decoder_sys_t::MAX_TEMPORAL_ID + 1;
+  p_sys->nbDroppedPictures = 0;
 }
 
 short chromaGreyValue(vlc_fourcc_t i_chroma)
@@ -542,12 +1122,93 @@ short chromaGreyValue(vlc_fourcc_t i_chroma)
   return greyChromaVal;
 }
 /*****************************************************************************
- * FillPicture:
+ * FillSemiPlanarPicture: NV12/P010 output, the chroma planes are interleaved
+ *****************************************************************************/
+static void FillSemiPlanarPicture(decoder_t* p_dec, picture_t* p_pic, int posx, int posy,
+  int picWidth, int picHeight, int bitDepth, short* planes[3], int strides[3], bool b_fillBelow, int scale)
+{
+  decoder_sys_t* p_sys = p_dec->p_sys;
+  const int sampleSize = p_pic->p[0].i_pixel_pitch;
+  // P010 keeps the 10-bit samples in the most significant bits
+  const int shift = (sampleSize == 2) ? 16 - 10 : 0;
+  // NV12 output of a 10-bit stream (vvc-output-depth)
+  const int ditherShift = (sampleSize == 1) ? bitDepth - 8 : 0;
+  for (int i = 0; i < 2; i++)
+  {
+    const plane_t* p_plane = &p_pic->p[i];
+    const int ratio = (i == 0) ? 1 : 2;
+    const int components = (i == 0) ? 1 : 2;
+    const int xOffset = (posx / ratio) * components * sampleSize;
+    const int yOffset = posy / ratio;
+    const int width = std::min(picWidth / ratio, (p_plane->i_visible_pitch - xOffset) / (components * sampleSize));
+    const int lines = std::max(0, std::min(picHeight / ratio, p_plane->i_visible_lines - yOffset));
+    if (width <= 0)
+      continue;
+    uint8_t* p_dstPlane = p_plane->p_pixels + yOffset * p_plane->i_pitch + xOffset;
+    int copiedLines = lines;
+    if (i == 0)
+    {
+      if (scale)
+        p_sys->pf_downscale(p_dstPlane, p_plane->i_pitch, planes[0], nullptr, strides[0], width, lines, scale, sampleSize, sampleSize == 1 ? ditherShift : shift);
+      else if (ditherShift > 0)
+        p_sys->pf_copy_dither(p_dstPlane, p_plane->i_pitch, planes[0], strides[0], width, lines, ditherShift);
+      else if (sampleSize == 1)
+        p_sys->pf_copy_narrow(p_dstPlane, p_plane->i_pitch, planes[0], strides[0], width, lines);
+      else
+        p_sys->pf_copy_shift(p_dstPlane, p_plane->i_pitch, planes[0], strides[0], width, lines, shift);
+    }
+    else if (planes[1] && planes[2])
+    {
+      if (scale)
+        p_sys->pf_downscale(p_dstPlane, p_plane->i_pitch, planes[1], planes[2], strides[1], width, lines, scale, sampleSize, sampleSize == 1 ? ditherShift : shift);
+      else if (ditherShift > 0)
+        p_sys->pf_interleave_dither(p_dstPlane, p_plane->i_pitch, planes[1], planes[2], strides[1], width, lines, ditherShift);
+      else if (sampleSize == 1)
+        p_sys->pf_interleave_narrow(p_dstPlane, p_plane->i_pitch, planes[1], planes[2], strides[1], width, lines);
+      else
+        p_sys->pf_interleave(p_dstPlane, p_plane->i_pitch, planes[1], planes[2], strides[1], width, lines, shift);
+    }
+    else
+    {
+      copiedLines = 0;
+    }
+
+    // black luma and grey chroma below the decoded picture
+    const int fillVal = (i == 0) ? 0 : 1 << (8 * sampleSize - 1);
+    const int fillEnd = b_fillBelow ? p_plane->i_visible_lines - yOffset : lines;
+    p_dstPlane += copiedLines * p_plane->i_pitch;
+    for (int y = copiedLines; y < fillEnd; y++)
+    {
+      if (sampleSize == 1)
+      {
+        memset(p_dstPlane, fillVal, width * components);
+      }
+      else
+      {
+        uint16_t* dst = (uint16_t*)p_dstPlane;
+        for (int x = 0; x < width * components; x++)
+        {
+          dst[x] = (uint16_t)fillVal;
+        }
+      }
+      p_dstPlane += p_plane->i_pitch;
+    }
+  }
+}
+
+/*****************************************************************************
+ * FillPicture: picWidth, picHeight, posx and posy are those of the output,
+ * the planes are downscaled by 1 << scale
  *****************************************************************************/
 static void FillPicture(decoder_t* p_dec, picture_t* p_pic, int posx, int posy,
-  int picWidth, int picHeight, short* planes[3], int strides[3])
+  int picWidth, int picHeight, int bitDepth, short* planes[3], int strides[3], bool b_fillBelow, int scale)
 {
   decoder_sys_t* p_sys = p_dec->p_sys;
+  if (p_pic->format.i_chroma == VLC_CODEC_NV12 || p_pic->format.i_chroma == VLC_CODEC_P010)
+  {
+    FillSemiPlanarPicture(p_dec, p_pic, posx, posy, picWidth, picHeight, bitDepth, planes, strides, b_fillBelow, scale);
+    return;
+  }
   for (int i = 0; i < p_pic->i_planes; i++)
   {
     if (planes[i])
@@ -562,31 +1223,31 @@ static void FillPicture(decoder_t* p_dec, picture_t* p_pic, int posx, int posy,
       uint8_t* p_dstPlane = p_pic->p[i].p_pixels + yOffset * p_pic->p[i].i_pitch + xOffset;
       const int lines = std::min(planeHeight, p_pic->p[i].i_visible_lines - yOffset);
       short* p_src = planes[i];
-      if (p_pic->p[i].i_pixel_pitch == 1)
+      if (p_pic->p[i].i_pixel_pitch == 1 && scale)
       {
-        for (int y = 0; y < lines; y++)
-        {
-          for (int x = 0; x < picPitch; x++)
-          {
-            p_dstPlane[x] = (uint8_t)p_src[x];
-          }
-          p_dstPlane += p_pic->p[i].i_pitch;
-          p_src += strides[i];
-        }
-        }
+        p_sys->pf_downscale(p_dstPlane, p_pic->p[i].i_pitch, p_src, nullptr, strides[i], picPitch, lines, scale, 1, std::max(0, bitDepth - 8));
+      }
+      else if (p_pic->p[i].i_pixel_pitch == 1 && bitDepth > 8)
+      {
+        p_sys->pf_copy_dither(p_dstPlane, p_pic->p[i].i_pitch, p_src, strides[i], picPitch, lines, bitDepth - 8);
+      }
+      else if (p_pic->p[i].i_pixel_pitch == 1)
+      {
+        p_sys->pf_copy_narrow(p_dstPlane, p_pic->p[i].i_pitch, p_src, strides[i], picPitch, lines);
+      }
       else if(picPitch > 0)
 
         {
-        for (int y = 0; y < lines; y++)
-        {
-          memcpy(p_dstPlane, p_src, picPitch);
-        p_dstPlane += p_pic->p[i].i_pitch;
-        p_src += strides[i];
-      }
+        if (scale)
+          p_sys->pf_downscale(p_dstPlane, p_pic->p[i].i_pitch, p_src, nullptr, strides[i], picPitch / 2, lines, scale, 2, 0);
+        else
+          p_sys->pf_copy(p_dstPlane, p_pic->p[i].i_pitch, p_src, strides[i], picPitch, std::max(0, lines));
+        p_dstPlane += std::max(0, lines) * p_pic->p[i].i_pitch;
         const int visibleWidth = picPitch / p_pic->p[i].i_pixel_pitch;
         const short fillVal = (i == 0) ? 0 : chromaGreyValue(p_dec->fmt_out.video.i_chroma);
 
-        for (int y = lines; y < p_pic->p[i].i_visible_lines - yOffset; y++)
+        const int fillEnd = b_fillBelow ? p_pic->p[i].i_visible_lines - yOffset : lines;
+        for (int y = lines; y < fillEnd; y++)
       {
         short* dst = (short*)p_dstPlane;
           for (int x = 0; x < visibleWidth; x++)
@@ -607,9 +1268,9 @@ static void FillPicture(decoder_t* p_dec, picture_t* p_pic, int posx, int posy,
       const int yOffset = (posy / heightRatio);
       const int picPitch = std::min(planeWidth * p_pic->p[i].i_pixel_pitch, p_pic->p[i].i_visible_pitch - xOffset);
       uint8_t* p_dstPlane = p_pic->p[i].p_pixels + yOffset * p_pic->p[i].i_pitch + xOffset;
-      //const int lines = std::min(planeHeight, p_pic->p[i].i_visible_lines - yOffset);
+      const int lines = b_fillBelow ? p_pic->p[i].i_visible_lines - yOffset : std::min(planeHeight, p_pic->p[i].i_visible_lines - yOffset);
       const int visibleWidth = picPitch / p_pic->p[i].i_pixel_pitch;
-      for (int y = 0; y < p_pic->p[i].i_visible_lines - yOffset; y++)
+      for (int y = 0; y < lines; y++)
         {
         short* dst = (short*)p_dstPlane;
         const short fillVal = (i == 0) ? 0 : chromaGreyValue(p_dec->fmt_out.video.i_chroma);
@@ -623,10 +1284,81 @@ static void FillPicture(decoder_t* p_dec, picture_t* p_pic, int posx, int posy,
   }
 }
 
+/*****************************************************************************
+ * CopyPicture: FillPicture split in horizontal bands over the copy threads
+ *****************************************************************************/
+struct copy_job_t
+{
+  decoder_t* p_dec;
+  picture_t* p_pic;
+  int posx, posy, picWidth, picHeight, bitDepth;
+  short** planes;
+  int* strides;
+  int chromaShiftX;
+  int chromaShiftY;
+  int bandHeight;
+  int nbBands;
+  // vvc-output-scale: the bands are downscaled into the picture
+  int scale;
+};
+
+static void CopyBand(void* opaque, int band)
+{
+  const copy_job_t* job = (const copy_job_t*)opaque;
+  const int y0 = band * job->bandHeight;
+  const int bandLines = std::min(job->bandHeight, job->picHeight - y0);
+  short* bandPlanes[3];
+  for (int i = 0; i < 3; i++)
+  {
+    const int y = (i == 0) ? y0 : y0 >> job->chromaShiftY;
+    bandPlanes[i] = job->planes[i] ? job->planes[i] + y * job->strides[i] : nullptr;
+  }
+  // only the last band fills the rest of the picture
+  const int scale = job->scale;
+  FillPicture(job->p_dec, job->p_pic, job->posx >> scale, (job->posy + y0) >> scale, job->picWidth >> scale,
+    bandLines >> scale, job->bitDepth, bandPlanes, job->strides, band == job->nbBands - 1, scale);
+}
+
+static void CopyPicture(decoder_t* p_dec, picture_t* p_pic, int posx, int posy,
+  int picWidth, int picHeight, int bitDepth, int chromaFormat, short* planes[3], int strides[3])
+{
+  decoder_sys_t* p_sys = p_dec->p_sys;
+  // bands of at least 64 lines
+  const int nbBands = std::max(1, std::min(2 * p_sys->copyPool.threadCount(), picHeight / 64));
+  const int scale = p_sys->outputScale;
+  if (nbBands == 1)
+  {
+    FillPicture(p_dec, p_pic, posx >> scale, posy >> scale, picWidth >> scale, picHeight >> scale, bitDepth, planes, strides, true, scale);
+    return;
+  }
+  copy_job_t job;
+  job.p_dec = p_dec;
+  job.p_pic = p_pic;
+  job.posx = posx;
+  job.posy = posy;
+  job.picWidth = picWidth;
+  job.picHeight = picHeight;
+  job.bitDepth = bitDepth;
+  job.planes = planes;
+  job.strides = strides;
+  job.chromaShiftX = (chromaFormat == 420 || chromaFormat == 422) ? 1 : 0;
+  job.chromaShiftY = (chromaFormat == 420) ? 1 : 0;
+  job.scale = scale;
+  // the dither pattern repeats every 8 output lines: the bands start on it, chroma included
+  const int bandAlign = std::max(16, 8 << (job.scale + job.chromaShiftY));
+  job.bandHeight = ((picHeight + nbBands - 1) / nbBands + bandAlign - 1) & ~(bandAlign - 1);
+  job.nbBands = (picHeight + job.bandHeight - 1) / job.bandHeight;
+  if (job.nbBands == 1)
+    CopyBand(&job, 0);
+  else
+    p_sys->copyPool.run(CopyBand, &job, job.nbBands);
+}
 
-static vlc_fourcc_t getVideoFormat(decoder_t* p_dec, int chromaFormat, const int bitDepths)
+static vlc_fourcc_t getVideoFormat(decoder_t* p_dec, int chromaFormat, int bitDepths)
 {
   vlc_fourcc_t videoFormat = p_dec->fmt_out.video.i_chroma; 
+  if (p_dec->p_sys->outputDepth == 8)
+    bitDepths = 8;
   switch (chromaFormat)
   {
   case 400:
@@ -646,11 +1378,11 @@ static vlc_fourcc_t getVideoFormat(decoder_t* p_dec, int chromaFormat, const int
   case 420:
     if (bitDepths == 8)
     {
-      videoFormat = VLC_CODEC_I420;
+      videoFormat = p_dec->p_sys->b_semiplanar ? VLC_CODEC_NV12 : VLC_CODEC_I420;
     }
     else if (bitDepths == 10)
     {
-      videoFormat = VLC_CODEC_I420_10L;
+      videoFormat = p_dec->p_sys->b_semiplanar ? VLC_CODEC_P010 : VLC_CODEC_I420_10L;
     }
     else if (bitDepths == 12)
     {
@@ -706,35 +1438,85 @@ static vlc_fourcc_t getVideoFormat(decoder_t* p_dec, decoder_sys_t* p_sys)
 static int DecodeFrame(decoder_t* p_dec, block_t* p_block)
 {
   decoder_sys_t* p_sys = p_dec->p_sys;
-  if (p_sys->b_frameRateDetect)
+  if (p_sys->b_placement_pending)
+  {
+    // the decoder thread is dedicated to this decoder: it keeps the placement
+    p_sys->b_placement_pending = false;
+    p_sys->placement.bind();
+  }
+  if (p_block && p_sys->b_thumbnail)
   {
-    if (p_sys->dts1 == VLC_TS_INVALID)
+    // the prerolled access units are before the requested time; a GDR
+    // picture is only refreshed at its recovery point, wait for an IDR or CRA
+    vvc_au_info_t auInfo;
+    if (p_sys->b_thumbnail_done || (p_block->i_flags & BLOCK_FLAG_PREROLL)
+      || !vvc_getAUInfo(p_block->p_buffer, p_block->i_buffer, &auInfo)
+      || (auInfo.nalType != VVC_NAL_CODED_SLICE_IDR_W_RADL && auInfo.nalType != VVC_NAL_CODED_SLICE_IDR_N_LP
+        && auInfo.nalType != VVC_NAL_CODED_SLICE_CRA))
     {
-      p_sys->dts1 = p_block->i_dts;
+      block_Release(p_block);
+      return VLCDEC_SUCCESS;
     }
-    else if (p_sys->dts2 == VLC_TS_INVALID && p_block->i_dts > p_sys->dts1)
+  }
+  if (p_block && (p_block->i_flags & VVC_BLOCK_FLAG_RESTART))
+  {
+    // trick-play: the packetizer dropped the access units before this IRAP,
+    // the pictures in the decoder are output and decoding starts over
+    vvc_au_info_t auInfo;
+    if (vvc_getAUInfo(p_block->p_buffer, p_block->i_buffer, &auInfo) && auInfo.isIrap)
     {
-      p_sys->diff_dts = p_block->i_dts - p_sys->dts1;
-      p_sys->dts2 = p_block->i_dts;
+      // end the last access unit first, or its picture is never output
+      vlc_mutex_lock(&p_sys->vtm_lock);
+      decVTM_decode(p_sys->decVtm, nullptr, 0, p_sys->speedUpLevel);
+      vlc_mutex_unlock(&p_sys->vtm_lock);
+      drainDecoder(p_dec);
+      vlc_mutex_lock(&p_sys->vtm_lock);
+      if (!p_sys->b_irap_only)
+        msg_Dbg(p_dec, "irap-only decoding");
+      p_sys->b_irap_only = true;
+      p_sys->b_skip_rasl = auInfo.nalType == VVC_NAL_CODED_SLICE_CRA;
+      vlc_mutex_unlock(&p_sys->vtm_lock);
     }
-    else if (p_block->i_dts > p_sys->dts2)
+  }
+  vlc_mutex_lock(&p_sys->vtm_lock);
+  if (p_block && (p_sys->b_wait_irap || p_sys->b_skip_rasl))
+  {
+    // after a flush, the pictures before the next IRAP and the RASL pictures
+    // of a CRA refer to pictures that are not decoded
+    vvc_au_info_t auInfo;
+    const bool b_info = vvc_getAUInfo(p_block->p_buffer, p_block->i_buffer, &auInfo);
+    if (b_info && p_sys->b_wait_irap && auInfo.isIrap)
     {
-      mtime_t diff_dts = p_block->i_dts - p_sys->dts2;
-      if (diff_dts == p_sys->diff_dts)
-      {
-        p_sys->b_frameRateDetect = false;
-        initVideoFrameRate(p_dec, p_sys, (unsigned int)(1000000 / (diff_dts / 1000)), 1000);
-        msg_Info(p_dec, "detected frame rate %d/%d, from timestamps",
-          p_dec->fmt_out.video.i_frame_rate,
-          p_dec->fmt_out.video.i_frame_rate_base);
-      }
-      else
-      {
-        p_sys->dts1 = VLC_TS_INVALID;
-        p_sys->dts2 = VLC_TS_INVALID;
-      }
+      p_sys->b_wait_irap = false;
+      p_sys->b_skip_rasl = auInfo.nalType == VVC_NAL_CODED_SLICE_CRA;
+    }
+    else if (b_info && p_sys->b_skip_rasl && auInfo.nalType != VVC_NAL_CODED_SLICE_RASL)
+    {
+      p_sys->b_skip_rasl = false;
+    }
+    if (p_sys->b_wait_irap || (b_info && p_sys->b_skip_rasl && auInfo.nalType == VVC_NAL_CODED_SLICE_RASL))
+    {
+      vlc_mutex_unlock(&p_sys->vtm_lock);
+      block_Release(p_block);
+      return VLCDEC_SUCCESS;
     }
   }
+  if (p_block && p_sys->b_irap_only)
+  {
+    vvc_au_info_t auInfo;
+    if (vvc_getAUInfo(p_block->p_buffer, p_block->i_buffer, &auInfo) && !auInfo.isIrap)
+    {
+      // back to normal playback: the pictures from here are reordered
+      msg_Dbg(p_dec, "end of irap-only decoding");
+      p_sys->b_irap_only = false;
+      if (!p_sys->b_low_delay)
+        switchToReorderedPts(p_sys);
+    }
+  }
+  if (p_sys->b_frameRateDetect && p_block && p_block->i_dts > VLC_TS_INVALID)
+  {
+    detectFrameRate(p_dec, p_sys, p_block->i_dts);
+  }
   if (p_block && p_sys->firstBlock)
   {
     p_sys->firstBlock = false;
@@ -748,14 +1530,102 @@ static int DecodeFrame(decoder_t* p_dec, block_t* p_block)
     }
   }
 
+  vvc_sps_dpb_t spsDpb;
+  if (p_block && vvc_getSpsDpb(p_block->p_buffer, p_block->i_buffer, &spsDpb))
+  {
+    // the output pictures are copies, the DPB is not in them: the decoder holds the picture
+    // being filled and a spare one, and outputs up to the reorder pictures back to back
+    const int extraPictureBuffers = std::min(p_sys->maxExtraPictureBuffers, spsDpb.maxNumReorderPics + 2);
+    if (extraPictureBuffers != p_dec->i_extra_picture_buffers)
+    {
+      msg_Dbg(p_dec, "sps %d: dpb size %d, %d reorder pictures, %d extra output pictures", spsDpb.spsId,
+        spsDpb.maxDecPicBuffering, spsDpb.maxNumReorderPics, extraPictureBuffers);
+      // used when the vout is (re)created: first format update, then format changes
+      p_dec->i_extra_picture_buffers = extraPictureBuffers;
+    }
+    const bool b_low_delay = p_sys->b_low_delay_mode && spsDpb.maxNumReorderPics == 0;
+    if (b_low_delay != p_sys->b_low_delay)
+    {
+      msg_Dbg(p_dec, "sps %d: %s output", spsDpb.spsId, b_low_delay ? "low-delay" : "reordered");
+      p_sys->b_low_delay = b_low_delay;
+      // irap-only decoding keeps its timestamps in decoding order until it ends
+      if (!p_sys->b_irap_only)
+      {
+        if (!b_low_delay)
+        {
+          switchToReorderedPts(p_sys);
+        }
+        else if (p_sys->b_reorderedPts)
+        {
+          // the pictures still in the decoder are output in the order of their timestamps
+          p_sys->pendingPts.assign(p_sys->reorderedPts.begin(), p_sys->reorderedPts.end());
+          p_sys->reorderedPts.clear();
+        }
+        else
+        {
+          // the pictures still in the decoder keep the extrapolated timestamps
+          p_sys->pendingPts.assign(std::max(0, (int)p_sys->dec_frame_count - (int)p_sys->out_frame_count), VLC_TS_INVALID);
+        }
+      }
+    }
+  }
+
+  // same preroll end as the decoder core: the dts of the first block after the preroll ones
+  const bool b_preroll = p_block && (p_block->i_flags & BLOCK_FLAG_PREROLL);
+  if (b_preroll)
+  {
+    p_sys->preroll_end = INT64_MAX;
+  }
+  else if (p_block && p_sys->preroll_end == INT64_MAX)
+  {
+    p_sys->preroll_end = p_block->i_dts > VLC_TS_INVALID ? p_block->i_dts : p_block->i_pts;
+  }
+
+  if (p_block && (p_sys->enable_hurryMode || b_preroll))
+  {
+    vvc_au_info_t auInfo;
+    if (vvc_getAUInfo(p_block->p_buffer, p_block->i_buffer, &auInfo))
+    {
+      p_sys->maxTid = std::max(p_sys->maxTid, auInfo.temporalId);
+      // when prerolling, non-reference pictures cannot contribute to the pictures after the seek target
+      if (!auInfo.isIrap && auInfo.isNonRef && (b_preroll || auInfo.temporalId >= p_sys->dropTid))
+      {
+        // nothing refers to this picture: skip it, its timestamp is not output; extrapolated
+        // timestamps (no timestamps in the blocks) skip its slot at the next output instead
+        p_sys->nbDroppedPictures++;
+        if (b_preroll)
+          p_sys->preroll_frame_count++;
+        else
+          p_sys->drop_frame_count++;
+        vlc_mutex_unlock(&p_sys->vtm_lock);
+        block_Release(p_block);
+        return VLCDEC_SUCCESS;
+      }
+    }
+  }
+
   //msg_Warn(p_dec, "decVtm decode frame %d with nalu size %d ", p_sys->dec_frame_count, (p_block != nullptr) ? p_block->i_buffer : 0);
+  const mtime_t decodeStart = mdate();
   decVTM_decode(p_sys->decVtm, (const char*)((p_block != nullptr) ? p_block->p_buffer : nullptr), (p_block != nullptr) ? p_block->i_buffer : 0, p_sys->speedUpLevel);
+  p_sys->stat_decode.add(mdate() - decodeStart);
   if (p_block != nullptr)
   {
     p_sys->dec_frame_count++;
+    if (p_sys->b_low_delay || p_sys->b_irap_only)
+      p_sys->pendingPts.push_back(p_block->i_pts > VLC_TS_INVALID ? p_block->i_pts : p_block->i_dts);
+    else if (p_sys->b_reorderedPts && p_block->i_pts > VLC_TS_INVALID)
+      p_sys->reorderedPts.insert(p_block->i_pts);
+    else if (p_sys->b_reorderedPts)
+    {
+      // one picture without timestamp would shift all the next ones
+      p_sys->b_reorderedPts = false;
+      p_sys->reorderedPts.clear();
+    }
   }
 
-  if (p_sys->b_format_init)
+  // the output thread owns the output format: it sets it with the first picture
+  bool b_updateFormat = false;
+  if (p_sys->b_format_init && !p_sys->b_async_output)
   {
     int width = 0, height = 0;
     decVTM_getFrameSize(p_sys->decVtm, &width, &height);
@@ -764,41 +1634,39 @@ static int DecodeFrame(decoder_t* p_dec, block_t* p_block)
     if (width > 0 && height > 0)
     {
       p_sys->b_format_init = false;
-      initVideoFormat(p_dec, p_sys, videoFormat, width, height);
-      if(decoder_UpdateVideoFormat(p_dec))
-	  {
-		  return false;
-	  }
+      initVideoFormat(p_dec, p_sys, videoFormat, width >> p_sys->outputScale, height >> p_sys->outputScale);
+      b_updateFormat = true;
     }
   }
+  vlc_mutex_unlock(&p_sys->vtm_lock);
+  if (b_updateFormat && updateVideoFormat(p_dec, p_sys))
+    return false;
 
-  while (getOutputFrame(p_dec, false, p_block? p_block->i_dts: VLC_TS_INVALID));
+  if (p_sys->b_async_output)
+    PushOutputRequest(p_sys, p_block ? p_block->i_dts : VLC_TS_INVALID, false, false);
+  else
+    while (getOutputFrame(p_dec, false, p_block? p_block->i_dts: VLC_TS_INVALID));
 
   if (p_block)
   {
     block_Release(p_block);
+    if (p_sys->b_thumbnail)
+    {
+      // no need to wait for the next pictures to get this one out
+      vlc_mutex_lock(&p_sys->vtm_lock);
+      decVTM_decode(p_sys->decVtm, nullptr, 0, p_sys->speedUpLevel);
+      vlc_mutex_unlock(&p_sys->vtm_lock);
+      drainDecoder(p_dec);
+      // set when the picture was queued, else the next IDR or CRA is tried
+      if (p_sys->b_thumbnail_done)
+        msg_Dbg(p_dec, "thumbnail decoded, skipping the rest of the stream");
+    }
   }
   else
   {
     msg_Warn(p_dec, "flushDecoder called at pts: %d ", date_Get(&p_sys->pts));
-    decVTM_flush(p_dec->p_sys->decVtm);
+    drainDecoder(p_dec);
     msg_Warn(p_dec, "decoder flushed ! ");
-    while (getOutputFrame(p_dec, true, VLC_TS_INVALID));
-
-    p_sys->b_first_frame = true;
-    p_sys->lastOutput_pts = VLC_TS_INVALID;
-    p_sys->firstOutput_pts = VLC_TS_INVALID;
-    p_sys->firstOutput_time = VLC_TS_INVALID;
-    p_sys->lastOutput_time = VLC_TS_INVALID;
-    p_sys->firstBlock_dts = VLC_TS_INVALID;
-    p_sys->firstBlock = true;
-    p_sys->b_format_init = true;
-    p_sys->b_frameRateDetect = false;
-    p_sys->speedUpLevel = 0;
-    p_sys->speedUpLevel_delai_increase = 0;
-    p_sys->speedUpLevel_delai_decrease = 0;
-    p_sys->speedUpLevel_previous_lateness = 0;
-    p_sys->speedUpLevel_delai_derivative = 0;
   }
   return VLCDEC_SUCCESS;
 }
@@ -813,13 +1681,24 @@ static bool getOutputFrame(decoder_t* p_dec, bool waitUntilReady, mtime_t i_dts)
   int bitDepths;
   int outputLayer = 0;
   int nbSkippedPictures = 0;
+  // the vout can block: its picture is taken before locking, Flush and the decoding go on meanwhile
+  if (!p_sys->p_spare && p_sys->b_vout_ready)
+    p_sys->p_spare = decoder_NewPicture(p_dec);
+  vlc_mutex_lock(&p_sys->vtm_lock);
   if (decVTM_getNextOutputFrame(p_sys->decVtm, waitUntilReady, planes, strides, &width, &height, &chromaFormat, &bitDepths, &outputLayer, &nbSkippedPictures))
   {
-    // Get a new picture 
+    if (p_sys->b_discard_output)
+    {
+      decVTM_setlastPicDisplayed(p_sys->decVtm);
+      vlc_mutex_unlock(&p_sys->vtm_lock);
+      return true;
+    }
     picture_t* p_pic = p_sys->p_pic;
     p_sys->out_frame_count++;
     vlc_fourcc_t videoFormat = getVideoFormat(p_dec, chromaFormat, bitDepths);
     bool outputLayerNew = true;
+    bool layoutChanged = false;
+    bool b_updateFormat = false;
     unsigned int outputLayerIdx = 0;
 
     for (unsigned int i=0; i<p_sys->outputLayers.size(); i++)
@@ -828,6 +1707,7 @@ static bool getOutputFrame(decoder_t* p_dec, bool waitUntilReady, mtime_t i_dts)
       {
         outputLayerIdx = i;
         outputLayerNew = false;
+        layoutChanged = p_sys->outputLayers[i].width != width || p_sys->outputLayers[i].height != height;
         p_sys->outputLayers[i].width = width;
         p_sys->outputLayers[i].height = height;
         break;
@@ -838,49 +1718,45 @@ static bool getOutputFrame(decoder_t* p_dec, bool waitUntilReady, mtime_t i_dts)
       outputLayerIdx = (unsigned int)p_sys->outputLayers.size();
       decoder_sys_t::layer_info layer = { outputLayer, width, height, 0, 0 };
       p_sys->outputLayers.push_back(layer);
+      layoutChanged = true;
       msg_Dbg(p_dec, "new layer nb %d: %d (total %d) ", outputLayerIdx, outputLayer, p_sys->outputLayers.size());
     }
     if (p_sys->outputLayers.size() > 1)
     {
-      int totalWidth = 0, totalHeight = 0;
-      for (auto& l : p_sys->outputLayers)
+      if (layoutChanged)
       {
-        l.posx = totalWidth;
-        l.posy = 0;
-        totalWidth += l.width;
-        totalHeight = std::max(totalHeight, l.height);
+        int totalWidth = 0, totalHeight = 0;
+        for (auto& l : p_sys->outputLayers)
+        {
+          l.posx = totalWidth;
+          l.posy = 0;
+          totalWidth += l.width;
+          totalHeight = std::max(totalHeight, l.height);
+        }
+        p_sys->layoutWidth = totalWidth;
+        p_sys->layoutHeight = totalHeight;
       }
-      width = totalWidth;
-      height = totalHeight;
+      width = p_sys->layoutWidth;
+      height = p_sys->layoutHeight;
     }
+    width >>= p_sys->outputScale;
+    height >>= p_sys->outputScale;
+    // the colour description is checked once per output picture, on its first layer
     if (width != p_dec->fmt_out.video.i_width
       || height != p_dec->fmt_out.video.i_height
-      || videoFormat != p_dec->fmt_out.video.i_chroma)
+      || videoFormat != p_dec->fmt_out.video.i_chroma
+      || (outputLayerIdx == 0 && colourDescriptionChanged(p_sys)))
     {
+      // the vout is updated once the lock is released
       initVideoFormat(p_dec, p_sys, videoFormat, width, height);
-      if(decoder_UpdateVideoFormat(p_dec))
-	  {
-		  return false;
-	  }
       initVideoFrameRate(p_dec, p_sys);
-    }
-
-    mtime_t dat = mdate();
-    if (planes[0] != nullptr)
-    {
-      if (!decoder_UpdateVideoFormat(p_dec) && (outputLayerIdx == 0 || outputLayerNew))
+      b_updateFormat = true;
+      if (p_sys->p_spare)
       {
-        p_pic = decoder_NewPicture(p_dec);
-        p_sys->p_pic = p_pic;
+        picture_Release(p_sys->p_spare);
+        p_sys->p_spare = NULL;
       }
-      if (p_pic == NULL)
-      {
-        return false;
-      }
-      FillPicture(p_dec, p_pic, p_sys->outputLayers[outputLayerIdx].posx, p_sys->outputLayers[outputLayerIdx].posy,
-        p_sys->outputLayers[outputLayerIdx].width, p_sys->outputLayers[outputLayerIdx].height, planes, strides);
     }
-    decVTM_setlastPicDisplayed(p_sys->decVtm);
 
     // Date management: 1 frame per packet 
     if (p_sys->b_first_frame)
@@ -892,27 +1768,101 @@ static bool getOutputFrame(decoder_t* p_dec, bool waitUntilReady, mtime_t i_dts)
       if (i_pts == VLC_TS_INVALID)
       {
         date_t firstBlockDate = p_sys->pts;
-        int decoderFrameDelay = std::min(p_dec->i_extra_picture_buffers, std::max(0, (int)p_sys->dec_frame_count - (int)p_sys->out_frame_count));
+        // pictures decoded before the first one out, more than the DPB with a multithreaded decoder
+        const int decoderFrameDelay = std::max(0, (int)p_sys->dec_frame_count - (int)p_sys->out_frame_count);
         date_Set(&firstBlockDate, p_sys->firstBlock_dts);
         date_Increment(&firstBlockDate, decoderFrameDelay);
         i_pts = date_Get(&firstBlockDate);
       }
       if (i_pts > VLC_TS_INVALID)
         date_Set(&p_sys->pts, i_pts);
+    }
 
+    if (outputLayerIdx == 0 && p_sys->reorderedPts.empty() && (nbSkippedPictures || p_sys->nbDroppedPictures))
+    {
+      date_Increment(&p_sys->pts, nbSkippedPictures + p_sys->nbDroppedPictures);
+    }
+    if (outputLayerIdx == 0)
+      p_sys->nbDroppedPictures = 0;
+    if (outputLayerIdx == 0 && !p_sys->reorderedPts.empty())
+    {
+      // output order is the order of the timestamps: the skipped pictures (RASL)
+      // come before this one, the dropped ones were never added
+      for (int i = 0; i < nbSkippedPictures && p_sys->reorderedPts.size() > 1; i++)
+        p_sys->reorderedPts.erase(p_sys->reorderedPts.begin());
+      date_Set(&p_sys->pts, *p_sys->reorderedPts.begin());
+      p_sys->reorderedPts.erase(p_sys->reorderedPts.begin());
+    }
+    else if (outputLayerIdx == 0 && (p_sys->b_low_delay || p_sys->b_irap_only))
+    {
+      // output order is decoding order: no need to wait for the decoder delay
+      for (int i = 0; i < nbSkippedPictures && !p_sys->pendingPts.empty(); i++)
+        p_sys->pendingPts.pop_front();
+      if (!p_sys->pendingPts.empty())
+      {
+        if (p_sys->pendingPts.front() > VLC_TS_INVALID)
+          date_Set(&p_sys->pts, p_sys->pendingPts.front());
+        p_sys->pendingPts.pop_front();
+      }
+    }
+    mtime_t i_pts = date_Get(&p_sys->pts);
+
+    if (p_sys->preroll_end > VLC_TS_INVALID)
+    {
+      if (i_pts < p_sys->preroll_end)
+      {
+        // the vout would drop it (before the seek target): no picture, no copy
+        decVTM_setlastPicDisplayed(p_sys->decVtm);
+        if (outputLayerIdx == 0)
+        {
+          p_sys->preroll_frame_count++;
+          date_Increment(&p_sys->pts, 1);
+        }
+        vlc_mutex_unlock(&p_sys->vtm_lock);
+        return true;
+      }
+      if (p_sys->preroll_end != INT64_MAX)
+        p_sys->preroll_end = VLC_TS_INVALID;
+    }
+    if (p_sys->firstOutput_time == VLC_TS_INVALID)
+    {
       p_sys->firstOutput_time = mdate();
       p_sys->firstOutput_pts = i_pts;
     }
 
-    if (outputLayerIdx == 0 && nbSkippedPictures)
+    mtime_t dat = mdate();
+    if (planes[0] != nullptr)
     {
-      date_Increment(&p_sys->pts, nbSkippedPictures);
+      if (outputLayerIdx == 0 || outputLayerNew)
+      {
+        // without a vout picture of the current format, copy to a picture of our own,
+        // handed over to the vout once the lock is released
+        // the picture of the previous layer 0 if its last layer never came
+        if (p_sys->p_pic)
+          picture_Release(p_sys->p_pic);
+        p_sys->b_pic_copy = !p_sys->p_spare;
+        p_pic = p_sys->p_spare ? p_sys->p_spare : picture_NewFromFormat(&p_dec->fmt_out.video);
+        p_sys->p_spare = NULL;
+        p_sys->p_pic = p_pic;
+      }
+      if (p_pic == NULL)
+      {
+        vlc_mutex_unlock(&p_sys->vtm_lock);
+        return false;
+      }
+      // under the lock: the output planes are only valid until the next decVTM call
+      const decoder_sys_t::layer_info& layer = p_sys->outputLayers[outputLayerIdx];
+      CopyPicture(p_dec, p_pic, layer.posx, layer.posy, layer.width, layer.height, bitDepths, chromaFormat, planes, strides);
+      p_sys->stat_copy.add(mdate() - dat);
     }
-    mtime_t i_pts = date_Get(&p_sys->pts);
+    decVTM_setlastPicDisplayed(p_sys->decVtm);
+
     if (outputLayerIdx == 0)
     {
       p_sys->lastOutput_pts = i_pts - p_sys->firstOutput_pts;
       p_sys->lastOutput_time = mdate() - p_sys->firstOutput_time;
+      p_sys->stat_lateness.add(p_sys->lastOutput_time - p_sys->lastOutput_pts);
+      p_sys->stat_queue.add((int64_t)p_sys->dec_frame_count - (int64_t)p_sys->out_frame_count);
 
       if (p_sys->enable_hurryMode)
       {
@@ -921,54 +1871,235 @@ static bool getOutputFrame(decoder_t* p_dec, bool waitUntilReady, mtime_t i_dts)
         mtime_t lateness_derivative = lateness - p_sys->speedUpLevel_previous_lateness;
         p_sys->speedUpLevel_previous_lateness = lateness;
         p_sys->speedUpLevel_delai_derivative = (7 * p_sys->speedUpLevel_delai_derivative + 1 * lateness_derivative) / 8;
-        if (p_sys->speedUpLevel < decoder_sys_t::MAX_SPEED_UP_LEVEL
+        // first drop the highest non-reference sub-layers (never TemporalId 0),
+        // then speed up the decoding of the remaining pictures
+        const bool canDrop = std::min(p_sys->dropTid, p_sys->maxTid + 1) > 1;
+        const bool isDropping = p_sys->dropTid <= p_sys->maxTid;
+        if ((canDrop || p_sys->speedUpLevel < p_sys->maxSpeedUpLevel)
           && p_sys->speedUpLevel_delai_derivative >= 0
           && lateness > period  && p_sys->speedUpLevel_delai_increase-- <= 0)
         {
-          p_sys->speedUpLevel_delai_increase = (1 << p_sys->speedUpLevel) * decoder_sys_t::SPDUP_DELAY_BASE;
-          p_sys->speedUpLevel = std::min(decoder_sys_t::MAX_SPEED_UP_LEVEL, p_sys->speedUpLevel + 2);
+          if (canDrop)
+          {
+            p_sys->dropTid = std::min(p_sys->dropTid, p_sys->maxTid + 1) - 1;
+            p_sys->speedUpLevel_delai_increase = decoder_sys_t::SPDUP_DELAY_BASE;
+          }
+          else
+          {
+            p_sys->speedUpLevel_delai_increase = (1 << p_sys->speedUpLevel) * decoder_sys_t::SPDUP_DELAY_BASE;
+            p_sys->speedUpLevel = std::min(p_sys->maxSpeedUpLevel, p_sys->speedUpLevel + 2);
+          }
           p_sys->speedUpLevel_delai_decrease = decoder_sys_t::SPDUP_DELAY_BASE;
         }
-        else if (p_sys->speedUpLevel > 0 
+        else if ((p_sys->speedUpLevel > p_sys->minSpeedUpLevel || isDropping)
           && p_sys->speedUpLevel_delai_derivative < 0
           && (lateness < -period && p_sys->speedUpLevel_delai_decrease-- <= 0))
         {
           p_sys->speedUpLevel_delai_decrease = (1 << p_sys->speedUpLevel) * decoder_sys_t::SPDUP_DELAY_BASE;
-          p_sys->speedUpLevel--;
+          if (p_sys->speedUpLevel > p_sys->minSpeedUpLevel)
+            p_sys->speedUpLevel--;
+          else
+            p_sys->dropTid = (p_sys->dropTid >= p_sys->maxTid) ? decoder_sys_t::MAX_TEMPORAL_ID + 1 : p_sys->dropTid + 1;
           p_sys->speedUpLevel_delai_increase = decoder_sys_t::SPDUP_DELAY_BASE;
         }
-        if (p_sys->speedUpLevel > 0)
-          msg_Info(p_dec, "decoding frame %d (delay %d, derivative %d) - speed up %d", p_sys->out_frame_count, lateness, p_sys->speedUpLevel_delai_derivative, p_sys->speedUpLevel);
+        if (p_sys->speedUpLevel > p_sys->minSpeedUpLevel || p_sys->dropTid <= p_sys->maxTid)
+          msg_Info(p_dec, "decoding frame %d (delay %d, derivative %d) - drop non-ref tid >= %d - speed up %d", p_sys->out_frame_count, lateness, p_sys->speedUpLevel_delai_derivative, p_sys->dropTid, p_sys->speedUpLevel);
       }
+      if (!p_sys->vtmThreads.isEmpty())
+        updateActiveThreads(p_dec, p_sys);
 
       date_Increment(&p_sys->pts, 1);
     }
 
-    if (planes[0] != nullptr && (outputLayerIdx == p_sys->outputLayers.size()-1 || outputLayerNew))
+    if (outputLayerIdx == 0)
     {
+      p_sys->stat_speedUp.add(p_sys->speedUpLevel);
+      if (p_sys->stats_interval > 0 && mdate() - p_sys->stats_last >= p_sys->stats_interval)
+      {
+        publishStats(p_dec, p_sys);
+      }
+    }
 
+    const bool b_queue = planes[0] != nullptr && (outputLayerIdx == p_sys->outputLayers.size()-1 || outputLayerNew);
+    if (b_queue && p_sys->flush_time != VLC_TS_INVALID)
+    {
+      p_sys->seekLatency = mdate() - p_sys->flush_time;
+      p_sys->flush_time = VLC_TS_INVALID;
+      msg_Dbg(p_dec, "first picture %lld us after flush", (long long)p_sys->seekLatency);
+    }
+    const bool b_pic_copy = p_sys->b_pic_copy;
+    // queued below: the next layers belong to a new picture
+    if (b_queue)
+      p_sys->p_pic = NULL;
+    vlc_mutex_unlock(&p_sys->vtm_lock);
+    // only negotiate again if the last attempt failed
+    if (b_updateFormat || (b_queue && !p_sys->b_vout_ready))
+      updateVideoFormat(p_dec, p_sys);
+    if (b_queue && b_pic_copy)
+    {
+      picture_t* p_voutPic = p_sys->b_vout_ready ? decoder_NewPicture(p_dec) : NULL;
+      if (p_voutPic)
+        picture_Copy(p_voutPic, p_pic);
+      picture_Release(p_pic);
+      p_pic = p_voutPic;
+    }
+    if (b_queue && p_pic)
+    {
       p_pic->date = i_pts;
       p_pic->b_force = true;
       p_pic->i_nb_fields = 2;
       p_pic->b_progressive = true;
 
       decoder_QueueVideo(p_dec, p_pic);
+      // read by DecodeFrame once the drain of the thumbnail access unit is over
+      if (p_sys->b_thumbnail)
+        p_sys->b_thumbnail_done = true;
     }
     return true;
   }
+  vlc_mutex_unlock(&p_sys->vtm_lock);
   return false;
 }
 
+/*****************************************************************************
+ * OutputThread: retrieves, copies and queues the decoded pictures
+ *****************************************************************************/
+static void* OutputThread(void* p_data)
+{
+  decoder_t* p_dec = (decoder_t*)p_data;
+  decoder_sys_t* p_sys = p_dec->p_sys;
+  for (;;)
+  {
+    decoder_sys_t::output_request req;
+    vlc_sem_wait(&p_sys->output_pending);
+    p_sys->output_queue.pop(req);
+    vlc_sem_post(&p_sys->output_free);
+    if (req.b_quit)
+    {
+      break;
+    }
+    while (getOutputFrame(p_dec, req.b_drain, req.i_dts));
+    if (req.b_drain)
+    {
+      vlc_sem_post(&p_sys->output_drained);
+    }
+  }
+  return NULL;
+}
+
+static void PushOutputRequest(decoder_sys_t* p_sys, mtime_t i_dts, bool b_drain, bool b_quit)
+{
+  decoder_sys_t::output_request req = { i_dts, b_drain, b_quit };
+  vlc_sem_wait(&p_sys->output_free);
+  p_sys->output_queue.push(req);
+  vlc_sem_post(&p_sys->output_pending);
+}
+
+/*****************************************************************************
+ * updateVideoFormat: negotiates fmt_out with the vout, b_vout_ready tells
+ * whether it succeeded
+ *****************************************************************************/
+static int updateVideoFormat(decoder_t* p_dec, decoder_sys_t* p_sys)
+{
+  p_sys->format_update_count++;
+  p_sys->b_vout_ready = !decoder_UpdateVideoFormat(p_dec);
+  return p_sys->b_vout_ready ? VLC_SUCCESS : VLC_EGENERIC;
+}
+
+/*****************************************************************************
+ * colourDescriptionChanged: the colour description of the stream differs from
+ * the one of the output format
+ *****************************************************************************/
+static bool colourDescriptionChanged(decoder_sys_t* p_sys)
+{
+  unsigned int colourDesc[] = { 0, 0, (unsigned int)-1, (unsigned int)-1, 0, 0 };
+  decVTM_getColourDescriptionInfo(p_sys->decVtm, &colourDesc[0], &colourDesc[1], &colourDesc[2],
+    &colourDesc[3], &colourDesc[4], &colourDesc[5]);
+  return memcmp(colourDesc, p_sys->colourDesc, sizeof(colourDesc)) != 0;
+}
+
+/*****************************************************************************
+ * publishStats: reports the statistics of the last interval
+ *****************************************************************************/
+static void publishStats(decoder_t* p_dec, decoder_sys_t* p_sys)
+{
+  const int64_t values[] = {
+    p_sys->stat_decode.percentile(50), p_sys->stat_decode.percentile(99),
+    p_sys->stat_copy.percentile(50), p_sys->stat_copy.percentile(99),
+    p_sys->stat_lateness.percentile(50), p_sys->stat_lateness.percentile(99),
+    p_sys->stat_queue.percentile(50), p_sys->stat_queue.percentile(99),
+    p_sys->stat_speedUp.max(),
+    (int64_t)p_sys->format_update_count,
+    p_sys->seekLatency,
+  };
+  static_assert(ARRAY_SIZE(values) == ARRAY_SIZE(ppsz_stats_vars), "one variable per statistic");
+  for (size_t i = 0; i < ARRAY_SIZE(values); i++)
+  {
+    var_SetInteger(p_dec, ppsz_stats_vars[i], values[i]);
+  }
+  msg_Dbg(p_dec, "stats over %d frames: decode p50 %d us p99 %d us, copy p50 %d us p99 %d us, "
+    "lateness p50 %d us p99 %d us, queue p50 %d p99 %d, speed up max %d, %d format updates, seek latency %d us",
+    (int)p_sys->stat_speedUp.count(), (int)values[0], (int)values[1], (int)values[2], (int)values[3],
+    (int)values[4], (int)values[5], (int)values[6], (int)values[7], (int)values[8], (int)values[9], (int)values[10]);
+
+  p_sys->stat_decode.reset();
+  p_sys->stat_copy.reset();
+  p_sys->stat_lateness.reset();
+  p_sys->stat_queue.reset();
+  p_sys->stat_speedUp.reset();
+  p_sys->stats_last = mdate();
+}
+
 /**
  * Common deinitialization
  */
 static void CloseDec(vlc_object_t* p_this)
 {
   decoder_t* p_dec = (decoder_t*)p_this;
+  decoder_sys_t* p_sys = p_dec->p_sys;
+  if (p_sys->b_async_output)
+  {
+    PushOutputRequest(p_sys, VLC_TS_INVALID, false, true);
+    vlc_join(p_sys->output_thread, NULL);
+    vlc_sem_destroy(&p_sys->output_pending);
+    vlc_sem_destroy(&p_sys->output_free);
+    vlc_sem_destroy(&p_sys->output_drained);
+  }
+  p_sys->copyPool.stop();
+  vlc_mutex_destroy(&p_sys->vtm_lock);
+  if (p_sys->p_spare)
+    picture_Release(p_sys->p_spare);
+  if (p_sys->p_pic)
+    picture_Release(p_sys->p_pic);
+  if (p_sys->stats_interval > 0)
+  {
+    publishStats(p_dec, p_sys);
+    for (const char* psz_var : ppsz_stats_vars)
+    {
+      var_Destroy(p_dec, psz_var);
+    }
+  }
   msg_Info(p_dec, "decoded %d frames",p_dec->p_sys->dec_frame_count);
   msg_Info(p_dec, "output %d frames",p_dec->p_sys->out_frame_count);
-  decVTM_flush(p_dec->p_sys->decVtm);
-  decVTM_destroy(p_dec->p_sys->decVtm);
+  msg_Info(p_dec, "dropped %d frames",p_dec->p_sys->drop_frame_count);
+  msg_Info(p_dec, "skipped %d preroll frames",p_dec->p_sys->preroll_frame_count);
+  msg_Info(p_dec, "%d output format updates",p_dec->p_sys->format_update_count);
+  p_sys->threadShare.release();
+  if (!p_sys->vtmThreads.isEmpty())
+  {
+    // an idle instance is reused with the cpus its threads had
+    p_sys->vtmThreads.restore();
+    var_Destroy(p_dec, "vvc-active-threads");
+  }
+  if (p_sys->maxIdleInstances > 0)
+  {
+    VvcDecoder::ReleaseInstance(p_sys->decVtm, p_sys->vtmThreads, p_sys->instanceKey, p_sys->maxIdleInstances);
+  }
+  else
+  {
+    decVTM_flush(p_dec->p_sys->decVtm);
+    decVTM_destroy(p_dec->p_sys->decVtm);
+  }
   video_format_Setup(&p_dec->fmt_out.video, VLC_CODEC_UNKNOWN, p_dec->fmt_out.video.i_width, p_dec->fmt_out.video.i_height, p_dec->fmt_out.video.i_visible_width, p_dec->fmt_out.video.i_visible_height-2, 1, 1);
   decoder_UpdateVideoFormat(p_dec);
   delete p_dec->p_sys;
@@ -0,0 +1,65 @@
+/*****************************************************************************
+ * LibVTMDec.h: synthetic stand-in of the libvtmdec API used by the plugin
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Selected with the CMake option USE_VTMDEC_MOCK, in place of the header of
+ * libvtmdec. The bitstream content is ignored: every non-empty access unit
+ * gives one picture per layer, filled with a moving gradient.
+ *
+ * The stream properties are read from the decoder options (vvc-opt):
+ *   --mock-size=WxH        size of the highest layer (1920x1080)
+ *   --mock-chroma=N        400, 420, 422 or 444 (420)
+ *   --mock-bitdepth=N      8, 10 or 12 (10)
+ *   --mock-fps=N[/D]       signalled frame rate, 0 if not signalled (50)
+ *   --mock-layers=N        number of output layers, each half the size of
+ *                          the next one (1)
+ *   --mock-delay=N         output delay in access units (2)
+ *   --mock-decode-us=N     decoding time of an access unit at speedUpLevel 0,
+ *                          divided by (1 + speedUpLevel) (0)
+ * The N lowest bits of the samples of an access unit decoded at speedUpLevel
+ * N are cleared, to give the decode levels a cost in quality.
+ * Other options are ignored.
+ *****************************************************************************/
+
+#ifndef LIBVTMDEC_MOCK_H_
+#define LIBVTMDEC_MOCK_H_
+
+#include <stddef.h>
+
+struct DecVTMInstance;
+
+DecVTMInstance* decVTM_create(int nbThreads, int nbThreadsForParsing, int targetLayerSet, const char* opt);
+void decVTM_destroy(DecVTMInstance* decVtm);
+
+int decVTM_decode(DecVTMInstance* decVtm, const char* buffer, size_t size, int speedUpLevel);
+void decVTM_flush(DecVTMInstance* decVtm);
+
+bool decVTM_getFrameSize(DecVTMInstance* decVtm, int* width, int* height);
+bool decVTM_getvideoFormat(DecVTMInstance* decVtm, int* chromaFormat, int* bitDepths);
+bool decVTM_getColourDescriptionInfo(DecVTMInstance* decVtm, unsigned int* primaries, unsigned int* transfer,
+  unsigned int* matrix, unsigned int* fullRange, unsigned int* maxCLL, unsigned int* maxFALL);
+bool decVTM_getFrameRate(DecVTMInstance* decVtm, unsigned int* frameRate, unsigned int* frameRateBase);
+
+bool decVTM_getNextOutputFrame(DecVTMInstance* decVtm, bool waitUntilReady, short* planes[3], int strides[3],
+  int* width, int* height, int* chromaFormat, int* bitDepths, int* layer, int* nbSkippedPictures);
+void decVTM_setlastPicDisplayed(DecVTMInstance* decVtm);
+
+#endif // LIBVTMDEC_MOCK_H_
@@ -0,0 +1,285 @@
+/*****************************************************************************
+ * vtmdec_mock.cpp: synthetic stand-in of libvtmdec
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "LibVTMDec.h"
+
+/* pictures are generated once, then cycled: the cost of the mock itself
+ * stays out of the measurements */
+static const int NB_SYNTHETIC_PICTURES = 8;
+/* VTM pictures have margins: keep the planes non contiguous as well */
+static const int PLANE_MARGIN = 32;
+/* pictures decoded at speedUpLevel N have their N lowest bits cleared */
+static const int NB_SPEED_UP_LEVELS = 5;
+
+struct synthetic_layer
+{
+  int width;
+  int height;
+  int strides[3];
+  std::vector<short> samples[NB_SPEED_UP_LEVELS][NB_SYNTHETIC_PICTURES][3];
+};
+
+struct DecVTMInstance
+{
+  int width = 1920;
+  int height = 1080;
+  int chromaFormat = 420;
+  int bitDepth = 10;
+  unsigned int frameRate = 50;
+  unsigned int frameRateBase = 1;
+  int nbLayers = 1;
+  int delay = 2;
+  int decodeTime = 0;
+
+  std::vector<synthetic_layer> layers;
+  bool b_format_known = false;
+  bool b_draining = false;
+  std::deque<int> speedUpLevels; // access units not output yet
+  uint64_t nbDecoded = 0;   // access units
+  uint64_t nbOutput = 0;    // pictures, all layers
+};
+
+static bool parseOption(const std::string& token, const char* psz_name, std::string& value)
+{
+  const size_t len = strlen(psz_name);
+  if (token.compare(0, len, psz_name) || token.size() <= len || token[len] != '=')
+    return false;
+  value = token.substr(len + 1);
+  return true;
+}
+
+static void parseOptions(DecVTMInstance* decVtm, const char* opt)
+{
+  if (!opt)
+    return;
+  std::string options(opt);
+  size_t pos = 0;
+  while (pos < options.size())
+  {
+    size_t end = options.find(' ', pos);
+    if (end == std::string::npos)
+      end = options.size();
+    const std::string token = options.substr(pos, end - pos);
+    pos = end + 1;
+
+    std::string value;
+    if (parseOption(token, "--mock-size", value))
+      sscanf(value.c_str(), "%dx%d", &decVtm->width, &decVtm->height);
+    else if (parseOption(token, "--mock-chroma", value))
+      decVtm->chromaFormat = atoi(value.c_str());
+    else if (parseOption(token, "--mock-bitdepth", value))
+      decVtm->bitDepth = atoi(value.c_str());
+    else if (parseOption(token, "--mock-fps", value))
+    {
+      decVtm->frameRateBase = 1;
+      sscanf(value.c_str(), "%u/%u", &decVtm->frameRate, &decVtm->frameRateBase);
+    }
+    else if (parseOption(token, "--mock-layers", value))
+      decVtm->nbLayers = atoi(value.c_str());
+    else if (parseOption(token, "--mock-delay", value))
+      decVtm->delay = atoi(value.c_str());
+    else if (parseOption(token, "--mock-decode-us", value))
+      decVtm->decodeTime = atoi(value.c_str());
+  }
+}
+
+static void fillLayer(synthetic_layer& layer, int chromaFormat, int bitDepth)
+{
+  const int maxValue = (1 << bitDepth) - 1;
+  const int shiftX = chromaFormat == 444 ? 0 : 1;
+  const int shiftY = chromaFormat == 420 ? 1 : 0;
+  const int nbPlanes = chromaFormat == 400 ? 1 : 3;
+  for (int n = 0; n < NB_SYNTHETIC_PICTURES; n++)
+  {
+    for (int c = 0; c < nbPlanes; c++)
+    {
+      const int w = c ? layer.width >> shiftX : layer.width;
+      const int h = c ? layer.height >> shiftY : layer.height;
+      layer.strides[c] = w + 2 * PLANE_MARGIN;
+      layer.samples[0][n][c].resize((size_t)layer.strides[c] * h);
+      short* p = layer.samples[0][n][c].data();
+      for (int y = 0; y < h; y++, p += layer.strides[c])
+      {
+        for (int x = 0; x < w; x++)
+        {
+          // diagonal gradient moving by 1/8 of the picture width per picture
+          const int v = c ? (x << 2) : ((x + y + n * (w >> 3)) << (bitDepth - 8));
+          p[x] = (short)(v & maxValue);
+        }
+      }
+    }
+  }
+}
+
+static std::vector<short>* getSamples(synthetic_layer& layer, int level, int n)
+{
+  std::vector<short>* samples = layer.samples[level][n];
+  if (level && samples[0].empty())
+  {
+    for (int c = 0; c < 3; c++)
+    {
+      samples[c] = layer.samples[0][n][c];
+      for (short& v : samples[c])
+        v = (short)((v >> level) << level);
+    }
+  }
+  return samples;
+}
+
+DecVTMInstance* decVTM_create(int nbThreads, int nbThreadsForParsing, int targetLayerSet, const char* opt)
+{
+  (void)nbThreads;
+  (void)nbThreadsForParsing;
+  (void)targetLayerSet;
+  DecVTMInstance* decVtm = new DecVTMInstance();
+  parseOptions(decVtm, opt);
+  if (decVtm->width <= 0 || decVtm->height <= 0 || decVtm->nbLayers <= 0 || decVtm->delay < 0 ||
+    (decVtm->chromaFormat != 400 && decVtm->chromaFormat != 420 && decVtm->chromaFormat != 422 && decVtm->chromaFormat != 444) ||
+    (decVtm->bitDepth != 8 && decVtm->bitDepth != 10 && decVtm->bitDepth != 12))
+  {
+    fprintf(stderr, "vtmdec mock: invalid options \"%s\"\n", opt ? opt : "");
+    delete decVtm;
+    return nullptr;
+  }
+
+  decVtm->layers.resize(decVtm->nbLayers);
+  for (int i = 0; i < decVtm->nbLayers; i++)
+  {
+    synthetic_layer& layer = decVtm->layers[i];
+    const int shift = decVtm->nbLayers - 1 - i;
+    layer.width = std::max(8, (decVtm->width >> shift) & ~7);
+    layer.height = std::max(8, (decVtm->height >> shift) & ~7);
+    fillLayer(layer, decVtm->chromaFormat, decVtm->bitDepth);
+  }
+  return decVtm;
+}
+
+void decVTM_destroy(DecVTMInstance* decVtm)
+{
+  delete decVtm;
+}
+
+int decVTM_decode(DecVTMInstance* decVtm, const char* buffer, size_t size, int speedUpLevel)
+{
+  if (!buffer || !size)
+    return 0;
+  if (decVtm->decodeTime > 0)
+    std::this_thread::sleep_for(std::chrono::microseconds(decVtm->decodeTime / (1 + std::max(0, speedUpLevel))));
+  decVtm->b_format_known = true;
+  decVtm->b_draining = false;
+  decVtm->speedUpLevels.push_back(std::min(std::max(speedUpLevel, 0), NB_SPEED_UP_LEVELS - 1));
+  decVtm->nbDecoded++;
+  return 0;
+}
+
+void decVTM_flush(DecVTMInstance* decVtm)
+{
+  decVtm->b_draining = true;
+}
+
+bool decVTM_getFrameSize(DecVTMInstance* decVtm, int* width, int* height)
+{
+  if (!decVtm->b_format_known)
+    return false;
+  *width = decVtm->layers.back().width;
+  *height = decVtm->layers.back().height;
+  return true;
+}
+
+bool decVTM_getvideoFormat(DecVTMInstance* decVtm, int* chromaFormat, int* bitDepths)
+{
+  if (!decVtm->b_format_known)
+    return false;
+  *chromaFormat = decVtm->chromaFormat;
+  *bitDepths = decVtm->bitDepth;
+  return true;
+}
+
+bool decVTM_getColourDescriptionInfo(DecVTMInstance* decVtm, unsigned int* primaries, unsigned int* transfer,
+  unsigned int* matrix, unsigned int* fullRange, unsigned int* maxCLL, unsigned int* maxFALL)
+{
+  (void)decVtm;
+  (void)primaries;
+  (void)transfer;
+  (void)matrix;
+  (void)fullRange;
+  (void)maxCLL;
+  (void)maxFALL;
+  return false;
+}
+
+bool decVTM_getFrameRate(DecVTMInstance* decVtm, unsigned int* frameRate, unsigned int* frameRateBase)
+{
+  if (!decVtm->b_format_known || !decVtm->frameRate || !decVtm->frameRateBase)
+    return false;
+  *frameRate = decVtm->frameRate;
+  *frameRateBase = decVtm->frameRateBase;
+  return true;
+}
+
+bool decVTM_getNextOutputFrame(DecVTMInstance* decVtm, bool waitUntilReady, short* planes[3], int strides[3],
+  int* width, int* height, int* chromaFormat, int* bitDepths, int* layer, int* nbSkippedPictures)
+{
+  (void)waitUntilReady;
+  uint64_t nbAvailable = decVtm->nbDecoded;
+  if (!decVtm->b_draining)
+    nbAvailable = nbAvailable > (uint64_t)decVtm->delay ? nbAvailable - decVtm->delay : 0;
+  if (decVtm->nbOutput >= nbAvailable * decVtm->layers.size())
+    return false;
+
+  const uint64_t au = decVtm->nbOutput / decVtm->layers.size();
+  const int layerIdx = (int)(decVtm->nbOutput % decVtm->layers.size());
+  synthetic_layer& l = decVtm->layers[layerIdx];
+  std::vector<short>* samples = getSamples(l, decVtm->speedUpLevels.front(), (int)(au % NB_SYNTHETIC_PICTURES));
+  for (int c = 0; c < 3; c++)
+  {
+    planes[c] = samples[c].empty() ? nullptr : samples[c].data();
+    strides[c] = planes[c] ? l.strides[c] : 0;
+  }
+  *width = l.width;
+  *height = l.height;
+  *chromaFormat = decVtm->chromaFormat;
+  *bitDepths = decVtm->bitDepth;
+  *layer = layerIdx;
+  *nbSkippedPictures = 0;
+  decVtm->nbOutput++;
+  if (layerIdx + 1 == (int)decVtm->layers.size())
+    decVtm->speedUpLevels.pop_front();
+  return true;
+}
+
+void decVTM_setlastPicDisplayed(DecVTMInstance* decVtm)
+{
+  // synthetic pictures are never overwritten
+  (void)decVtm;
+}
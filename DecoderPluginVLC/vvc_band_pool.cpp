@@ -0,0 +1,119 @@
+/*****************************************************************************
+ * vvc_band_pool.cpp: helper threads splitting a picture copy in bands
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#include <system_error>
+
+#include "vvc_band_pool.h"
+
+using namespace VvcDecoder;
+
+BandPool::BandPool()
+  : m_job(nullptr)
+  , m_opaque(nullptr)
+  , m_nbBands(0)
+  , m_nextBand(0)
+  , m_pendingBands(0)
+  , m_generation(0)
+  , m_quit(false)
+{
+}
+
+BandPool::~BandPool()
+{
+  stop();
+}
+
+bool BandPool::start(int nbHelpers)
+{
+  m_quit = false;
+  for (int i = 0; i < nbHelpers; i++)
+  {
+    try
+    {
+      m_helpers.emplace_back(&BandPool::helperLoop, this);
+    }
+    catch (const std::system_error&)
+    {
+      return !m_helpers.empty();
+    }
+  }
+  return true;
+}
+
+void BandPool::stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_lock);
+    m_quit = true;
+  }
+  m_wake.notify_all();
+  for (std::thread& helper : m_helpers)
+    helper.join();
+  m_helpers.clear();
+}
+
+// takes the next band of the current job, the lock is held
+bool BandPool::runBand()
+{
+  if (m_nextBand >= m_nbBands)
+    return false;
+  const int band = m_nextBand++;
+  m_lock.unlock();
+  m_job(m_opaque, band);
+  m_lock.lock();
+  if (--m_pendingBands == 0)
+    m_done.notify_one();
+  return true;
+}
+
+void BandPool::helperLoop()
+{
+  std::unique_lock<std::mutex> lock(m_lock);
+  unsigned generation = m_generation;
+  for (;;)
+  {
+    m_wake.wait(lock, [&] { return m_quit || m_generation != generation; });
+    if (m_quit)
+      return;
+    generation = m_generation;
+    while (runBand());
+  }
+}
+
+void BandPool::run(band_job_t job, void* opaque, int nbBands)
+{
+  if (m_helpers.empty() || nbBands <= 1)
+  {
+    for (int band = 0; band < nbBands; band++)
+      job(opaque, band);
+    return;
+  }
+  std::unique_lock<std::mutex> lock(m_lock);
+  m_job = job;
+  m_opaque = opaque;
+  m_nbBands = nbBands;
+  m_nextBand = 0;
+  m_pendingBands = nbBands;
+  m_generation++;
+  m_wake.notify_all();
+  while (runBand());
+  m_done.wait(lock, [&] { return m_pendingBands == 0; });
+}
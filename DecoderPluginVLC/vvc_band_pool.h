@@ -0,0 +1,69 @@
+/*****************************************************************************
+ * vvc_band_pool.h: helper threads splitting a picture copy in bands
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VVC_BAND_POOL_H_
+#define VVC_BAND_POOL_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace VvcDecoder
+{
+  /* Runs the bands of a job on helper threads and on the calling thread,
+   * for the output copy of a picture to take a fraction of its time.
+   * run() is only called from one thread at a time. */
+  class BandPool
+  {
+  public:
+    typedef void (*band_job_t)(void* opaque, int band);
+
+    BandPool();
+    ~BandPool();
+
+    /* the helpers inherit the cpus of the calling thread */
+    bool start(int nbHelpers);
+    void stop();
+    int threadCount() const { return (int)m_helpers.size() + 1; }
+
+    /* returns once job(opaque, band) ran for every band in [0, nbBands) */
+    void run(band_job_t job, void* opaque, int nbBands);
+
+  private:
+    void helperLoop();
+    bool runBand();
+
+    std::vector<std::thread> m_helpers;
+    std::mutex m_lock;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    band_job_t m_job;
+    void* m_opaque;
+    int m_nbBands;
+    int m_nextBand;
+    int m_pendingBands;
+    unsigned m_generation;
+    bool m_quit;
+  };
+}
+
+#endif // VVC_BAND_POOL_H_
@@ -0,0 +1,638 @@
+/*****************************************************************************
+ * vvc_cpu.cpp: placement of the decoder threads on cpus and NUMA nodes
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+# define _GNU_SOURCE
+#endif
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+#include <string>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+# include <dirent.h>
+# include <sched.h>
+# include <sys/prctl.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+#endif
+
+#include "vvc_cpu.h"
+
+namespace VvcDecoder
+{
+
+bool ParseCpuList(const char* psz_cpuList, std::vector<int>& cpus)
+{
+  cpus.clear();
+  const char* p = psz_cpuList;
+  while (*p)
+  {
+    char* end;
+    const long first = strtol(p, &end, 10);
+    if (end == p || first < 0)
+      return false;
+    long last = first;
+    p = end;
+    if (*p == '-')
+    {
+      last = strtol(p + 1, &end, 10);
+      if (end == p + 1 || last < first)
+        return false;
+      p = end;
+    }
+    for (long cpu = first; cpu <= last; cpu++)
+      cpus.push_back((int)cpu);
+    if (*p == ',')
+      p++;
+    else if (*p && *p != '\n')
+      return false;
+    else
+      break;
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return true;
+}
+
+ThreadGroup::ThreadGroup()
+  : m_cores(0)
+  , m_offset(0)
+  , m_active(0)
+{
+  m_savedName[0] = '\0';
+}
+
+static std::mutex s_groupLock;
+// first cpu of the next group, so that restricted groups do not pile up on the same cpus
+static size_t s_groupNextCpu = 0;
+// number in the name of the next group
+static unsigned s_groupNextId = 0;
+
+ThreadPlacement::ThreadPlacement()
+  : m_active(false)
+  , m_bound(false)
+  , m_node(-1)
+  , m_savedPolicy(0)
+{
+  memset(m_savedNodes, 0, sizeof(m_savedNodes));
+}
+
+#if defined(__linux__)
+
+// from linux/mempolicy.h, not always installed
+static const int VVC_MPOL_DEFAULT = 0;
+static const int VVC_MPOL_PREFERRED = 1;
+
+static bool getThreadCpus(std::vector<int>& cpus, pid_t tid = 0)
+{
+  cpu_set_t set;
+  if (sched_getaffinity(tid, sizeof(set), &set))
+    return false;
+  cpus.clear();
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+  {
+    if (CPU_ISSET(cpu, &set))
+      cpus.push_back(cpu);
+  }
+  return true;
+}
+
+static bool setThreadCpus(const std::vector<int>& cpus, pid_t tid = 0)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (int cpu : cpus)
+  {
+    if (cpu < CPU_SETSIZE)
+      CPU_SET(cpu, &set);
+  }
+  return !sched_setaffinity(tid, sizeof(set), &set);
+}
+
+bool ThreadPlacement::init(const char* psz_cpuList, int numaNode)
+{
+  m_active = false;
+  m_node = numaNode;
+  std::vector<int> cpus;
+  if (psz_cpuList && *psz_cpuList)
+  {
+    if (!ParseCpuList(psz_cpuList, cpus))
+      return false;
+  }
+  else if (numaNode < 0)
+  {
+    return true; // nothing to do
+  }
+
+  if (numaNode >= 0)
+  {
+    if (numaNode >= MAX_NUMA_NODES)
+      return false;
+    char psz_path[64];
+    snprintf(psz_path, sizeof(psz_path), "/sys/devices/system/node/node%d/cpulist", numaNode);
+    FILE* f = fopen(psz_path, "r");
+    if (!f)
+      return false;
+    char psz_nodeCpus[1024] = "";
+    const bool b_read = fgets(psz_nodeCpus, sizeof(psz_nodeCpus), f) != NULL;
+    fclose(f);
+    std::vector<int> nodeCpus;
+    if (!b_read || !ParseCpuList(psz_nodeCpus, nodeCpus))
+      return false;
+    if (cpus.empty())
+    {
+      cpus = nodeCpus;
+    }
+    else
+    {
+      std::vector<int> both;
+      std::set_intersection(cpus.begin(), cpus.end(), nodeCpus.begin(), nodeCpus.end(), std::back_inserter(both));
+      cpus.swap(both);
+    }
+  }
+
+  // only keep the cpus this process may run on
+  std::vector<int> allowed;
+  if (!getThreadCpus(allowed))
+    return false;
+  std::vector<int> usable;
+  std::set_intersection(cpus.begin(), cpus.end(), allowed.begin(), allowed.end(), std::back_inserter(usable));
+  if (usable.empty())
+    return false;
+  m_cpus.swap(usable);
+  m_active = true;
+  return true;
+}
+
+bool ThreadPlacement::bind()
+{
+  if (!m_active)
+    return false;
+  if (!getThreadCpus(m_savedCpus) || !setThreadCpus(m_cpus))
+    return false;
+  m_bound = true;
+
+  if (m_node >= 0)
+  {
+    // memory is preferably allocated on the node, then elsewhere if it is full
+    if (syscall(SYS_get_mempolicy, &m_savedPolicy, m_savedNodes, (unsigned long)MAX_NUMA_NODES, NULL, 0UL))
+    {
+      m_savedPolicy = VVC_MPOL_DEFAULT;
+      memset(m_savedNodes, 0, sizeof(m_savedNodes));
+    }
+    unsigned long nodes[MAX_NUMA_NODES / (8 * sizeof(unsigned long))] = { 0 };
+    nodes[m_node / (8 * sizeof(unsigned long))] |= 1UL << (m_node % (8 * sizeof(unsigned long)));
+    syscall(SYS_set_mempolicy, VVC_MPOL_PREFERRED, nodes, (unsigned long)MAX_NUMA_NODES + 1);
+  }
+  return true;
+}
+
+void ThreadPlacement::unbind()
+{
+  if (!m_bound)
+    return;
+  setThreadCpus(m_savedCpus);
+  if (m_node >= 0)
+  {
+    if (m_savedPolicy == VVC_MPOL_DEFAULT)
+      syscall(SYS_set_mempolicy, VVC_MPOL_DEFAULT, NULL, 0UL);
+    else
+      syscall(SYS_set_mempolicy, m_savedPolicy, m_savedNodes, (unsigned long)MAX_NUMA_NODES + 1);
+  }
+  m_bound = false;
+}
+
+static bool readLine(const std::string& path, std::string& line)
+{
+  FILE* f = fopen(path.c_str(), "r");
+  if (!f)
+    return false;
+  char buf[256];
+  const bool b_read = fgets(buf, sizeof(buf), f) != NULL;
+  fclose(f);
+  if (!b_read)
+    return false;
+  line = buf;
+  while (!line.empty() && (line.back() == '\n' || line.back() == ' '))
+    line.pop_back();
+  return true;
+}
+
+/* quota of a cgroup directory, in cpus (rounded up), 0 if none */
+static int cgroupQuota(const std::string& dir, bool b_v2)
+{
+  long long quota = -1, period = 0;
+  std::string line;
+  if (b_v2)
+  {
+    // cpu.max: "$MAX $PERIOD", $MAX is "max" without limit
+    if (!readLine(dir + "/cpu.max", line) || sscanf(line.c_str(), "%lld %lld", &quota, &period) != 2)
+      return 0;
+  }
+  else
+  {
+    if (!readLine(dir + "/cpu.cfs_quota_us", line) || sscanf(line.c_str(), "%lld", &quota) != 1)
+      return 0;
+    if (!readLine(dir + "/cpu.cfs_period_us", line) || sscanf(line.c_str(), "%lld", &period) != 1)
+      return 0;
+  }
+  if (quota <= 0 || period <= 0)
+    return 0;
+  return (int)((quota + period - 1) / period);
+}
+
+/* lowest quota along the cgroup hierarchy of the process, 0 if none */
+static int getCgroupQuota()
+{
+  FILE* f = fopen("/proc/self/cgroup", "r");
+  if (!f)
+    return 0;
+  int quotaCpus = 0;
+  char buf[1024];
+  while (fgets(buf, sizeof(buf), f))
+  {
+    // "hierarchy-ID:controller-list:cgroup-path"
+    std::string line(buf);
+    while (!line.empty() && line.back() == '\n')
+      line.pop_back();
+    const size_t first = line.find(':');
+    const size_t second = first == std::string::npos ? first : line.find(':', first + 1);
+    if (second == std::string::npos)
+      continue;
+    const std::string controllers = line.substr(first + 1, second - first - 1);
+    std::string path = line.substr(second + 1);
+    const bool b_v2 = line.compare(0, first, "0") == 0 && controllers.empty();
+    std::string mount;
+    if (b_v2)
+    {
+      // hybrid hierarchies mount cgroup v2 on unified/
+      std::string content;
+      mount = readLine("/sys/fs/cgroup/unified/cgroup.controllers", content) ? "/sys/fs/cgroup/unified" : "/sys/fs/cgroup";
+    }
+    else
+    {
+      bool b_cpu = false;
+      size_t pos = 0;
+      while (pos <= controllers.size())
+      {
+        size_t end = controllers.find(',', pos);
+        if (end == std::string::npos)
+          end = controllers.size();
+        b_cpu |= controllers.compare(pos, end - pos, "cpu") == 0;
+        pos = end + 1;
+      }
+      if (!b_cpu)
+        continue;
+      mount = "/sys/fs/cgroup/" + controllers;
+    }
+
+    // the limit can be set on any ancestor. Inside a container, the path may
+    // not be visible: the root of the mount is then the container cgroup
+    for (;;)
+    {
+      const int quota = cgroupQuota(mount + path, b_v2);
+      if (quota > 0 && (!quotaCpus || quota < quotaCpus))
+        quotaCpus = quota;
+      if (path.empty() || path == "/")
+        break;
+      const size_t slash = path.rfind('/');
+      path.erase(slash == std::string::npos ? 0 : slash);
+    }
+  }
+  fclose(f);
+  return quotaCpus;
+}
+
+/* SMT siblings share the same core_cpus_list (thread_siblings_list before linux 5.7) */
+static bool getCoreSiblings(int cpu, std::string& siblings)
+{
+  const std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+  return readLine(topology + "core_cpus_list", siblings) || readLine(topology + "thread_siblings_list", siblings);
+}
+
+/* puts one cpu of each core first and their SMT siblings after, returns the
+ * number of cores (all the cpus if the topology is unknown) */
+static int orderByCore(std::vector<int>& cpus)
+{
+  std::vector<std::string> cores;
+  std::vector<int> first, siblings;
+  for (int cpu : cpus)
+  {
+    std::string core;
+    if (!getCoreSiblings(cpu, core))
+      return (int)cpus.size();
+    if (std::find(cores.begin(), cores.end(), core) == cores.end())
+    {
+      cores.push_back(core);
+      first.push_back(cpu);
+    }
+    else
+    {
+      siblings.push_back(cpu);
+    }
+  }
+  cpus.swap(first);
+  cpus.insert(cpus.end(), siblings.begin(), siblings.end());
+  return (int)cores.size();
+}
+
+bool GetCpuInfo(const std::vector<int>* cpus, cpu_info_t* info)
+{
+  std::vector<int> threadCpus;
+  if (!cpus)
+  {
+    if (!getThreadCpus(threadCpus))
+      return false;
+    cpus = &threadCpus;
+  }
+  info->logicalCpus = (int)cpus->size();
+
+  std::vector<std::string> cores;
+  for (int cpu : *cpus)
+  {
+    std::string siblings;
+    if (!getCoreSiblings(cpu, siblings))
+    {
+      cores.clear();
+      break;
+    }
+    if (std::find(cores.begin(), cores.end(), siblings) == cores.end())
+      cores.push_back(siblings);
+  }
+  info->physicalCores = cores.empty() ? info->logicalCpus : (int)cores.size();
+  info->quotaCpus = getCgroupQuota();
+  return info->logicalCpus > 0;
+}
+
+void ThreadGroup::begin()
+{
+  m_tids.clear();
+  if (prctl(PR_GET_NAME, m_savedName, 0, 0, 0))
+    m_savedName[0] = '\0';
+  char name[16];
+  {
+    std::lock_guard<std::mutex> lock(s_groupLock);
+    snprintf(name, sizeof(name), "vvcdec-%u", s_groupNextId++);
+  }
+  prctl(PR_SET_NAME, name, 0, 0, 0);
+}
+
+void ThreadGroup::end()
+{
+  char name[16] = "";
+  prctl(PR_GET_NAME, name, 0, 0, 0);
+  prctl(PR_SET_NAME, m_savedName, 0, 0, 0);
+
+  const pid_t self = (pid_t)syscall(SYS_gettid);
+  m_tids.clear();
+  m_savedCpus.clear();
+  DIR* dir = opendir("/proc/self/task");
+  while (dir && name[0])
+  {
+    struct dirent* entry = readdir(dir);
+    if (!entry)
+      break;
+    const int tid = atoi(entry->d_name);
+    std::string comm;
+    if (tid <= 0 || tid == self || !readLine(std::string("/proc/self/task/") + entry->d_name + "/comm", comm) || comm != name)
+      continue;
+    std::vector<int> cpus;
+    if (getThreadCpus(cpus, tid))
+    {
+      m_tids.push_back(tid);
+      m_savedCpus.push_back(cpus);
+    }
+  }
+  if (dir)
+    closedir(dir);
+
+  // the new threads have the cpus of the creating thread
+  if (m_tids.empty() || !getThreadCpus(m_cpus) || m_cpus.empty())
+  {
+    m_tids.clear();
+    m_savedCpus.clear();
+    m_cpus.clear();
+  }
+  else
+  {
+    // the restricted groups are spread over the cores before their SMT siblings
+    m_cores = orderByCore(m_cpus);
+    std::lock_guard<std::mutex> lock(s_groupLock);
+    m_offset = s_groupNextCpu % m_cores;
+    s_groupNextCpu += m_tids.size();
+  }
+  m_active = cpuCount();
+}
+
+bool ThreadGroup::restrict(int count)
+{
+  if (m_tids.empty())
+    return false;
+  count = std::max(1, std::min(count, cpuCount()));
+  bool b_ok = true;
+  if (count == cpuCount())
+  {
+    // no restriction: the cpus they were found with
+    for (size_t i = 0; i < m_tids.size(); i++)
+      b_ok &= setThreadCpus(m_savedCpus[i], m_tids[i]);
+  }
+  else
+  {
+    std::vector<int> cpus;
+    for (int i = 0; i < count; i++)
+      cpus.push_back(i < m_cores ? m_cpus[(m_offset + i) % m_cores] : m_cpus[i]);
+    for (int tid : m_tids)
+      b_ok &= setThreadCpus(cpus, tid);
+  }
+  m_active = count;
+  return b_ok;
+}
+
+void ThreadGroup::restore()
+{
+  restrict(cpuCount());
+}
+
+#else
+
+void ThreadGroup::begin()
+{
+}
+
+void ThreadGroup::end()
+{
+}
+
+bool ThreadGroup::restrict(int count)
+{
+  (void)count;
+  return false;
+}
+
+void ThreadGroup::restore()
+{
+}
+
+bool ThreadPlacement::init(const char* psz_cpuList, int numaNode)
+{
+  m_active = false;
+  m_node = numaNode;
+  return (!psz_cpuList || !*psz_cpuList) && numaNode < 0;
+}
+
+bool ThreadPlacement::bind()
+{
+  return false;
+}
+
+void ThreadPlacement::unbind()
+{
+}
+
+bool GetCpuInfo(const std::vector<int>* cpus, cpu_info_t* info)
+{
+  (void)cpus;
+  (void)info;
+  return false;
+}
+
+#endif
+
+/*****************************************************************************
+ * Thread budget shared by the decoders of the process
+ *****************************************************************************/
+static std::mutex s_budgetLock;
+static std::vector<ThreadShare*> s_budgetShares;  // running decoders
+static int s_budgetThreads = 0;                    // threads split between them, see acquire()
+
+static uint64_t budgetWeight()
+{
+  uint64_t weight = 0;
+  for (const ThreadShare* share : s_budgetShares)
+    weight += share->weight();
+  return weight;
+}
+
+static void updateShared()
+{
+  for (ThreadShare* share : s_budgetShares)
+    share->setShared(s_budgetShares.size() > 1);
+}
+
+static int fairShare(uint64_t weight, uint64_t totalWeight)
+{
+  return std::max(1, (int)((s_budgetThreads * weight + totalWeight / 2) / totalWeight));
+}
+
+ThreadShare::ThreadShare()
+  : m_weight(0)
+  , m_pool(0)
+  , m_threads(0)
+  , m_shared(false)
+{
+}
+
+ThreadShare::~ThreadShare()
+{
+  release();
+}
+
+int ThreadShare::acquire(int totalThreads, uint64_t weight, int* decoders)
+{
+  std::lock_guard<std::mutex> lock(s_budgetLock);
+  m_weight = std::max<uint64_t>(1, weight);
+  m_pool = 0;
+  // the largest thread count of the decoders registered since the budget was
+  // last empty: a decoder opened with fewer cpus (affinity, quota) does not
+  // take cores from the others, it only gets fewer threads itself
+  if (s_budgetShares.empty())
+    s_budgetThreads = 0;
+  s_budgetShares.push_back(this);
+  s_budgetThreads = std::max(s_budgetThreads, totalThreads);
+  *decoders = (int)s_budgetShares.size();
+  updateShared();
+
+  // the others come down to their new share, the fixed ones keep what they have
+  const uint64_t totalWeight = budgetWeight();
+  int used = 0;
+  for (ThreadShare* share : s_budgetShares)
+  {
+    if (share == this)
+      continue;
+    if (share->m_pool)
+      share->m_threads = std::min((int)share->m_threads, fairShare(share->m_weight, totalWeight));
+    used += share->m_threads;
+  }
+  m_threads = std::max(1, std::min(std::min(fairShare(m_weight, totalWeight), totalThreads), s_budgetThreads - used));
+  return m_threads;
+}
+
+void ThreadShare::release()
+{
+  std::lock_guard<std::mutex> lock(s_budgetLock);
+  if (!m_weight)
+    return;
+  s_budgetShares.erase(std::find(s_budgetShares.begin(), s_budgetShares.end(), this));
+  m_weight = 0;
+  m_pool = 0;
+  m_threads = 0;
+  m_shared = false;
+  updateShared();
+
+  // the threads left free go back to the resizable decoders
+  const uint64_t totalWeight = budgetWeight();
+  int available = s_budgetThreads;
+  for (const ThreadShare* share : s_budgetShares)
+    available -= share->m_threads;
+  for (ThreadShare* share : s_budgetShares)
+  {
+    if (available <= 0)
+      break;
+    const int target = std::min(fairShare(share->m_weight, totalWeight), share->m_pool);
+    const int added = std::min(target - share->m_threads, available);
+    if (added > 0)
+    {
+      share->m_threads += added;
+      available -= added;
+    }
+  }
+}
+
+void ThreadShare::setResizable(int pool)
+{
+  std::lock_guard<std::mutex> lock(s_budgetLock);
+  if (m_weight)
+  {
+    m_pool = std::max(1, pool);
+    m_threads = std::min((int)m_threads, m_pool);
+  }
+}
+
+}
@@ -0,0 +1,155 @@
+/*****************************************************************************
+ * vvc_cpu.h: placement of the decoder threads on cpus and NUMA nodes
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VVC_CPU_H_
+#define VVC_CPU_H_
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include <stdint.h>
+
+namespace VvcDecoder
+{
+  /* Binds threads to a set of cpus and their memory to a NUMA node.
+   * Threads created by a bound thread inherit its placement, which is how
+   * the threads of the VTM pool are placed. Only supported on Linux. */
+  class ThreadPlacement
+  {
+  public:
+    ThreadPlacement();
+
+    /* cpus from a cpulist ("0-3,8-11", empty: all) restricted to the cpus of
+     * a NUMA node (-1: no node). Returns false if the resulting set is empty
+     * or placement is not supported. */
+    bool init(const char* psz_cpuList, int numaNode);
+    bool isActive() const { return m_active; }
+    int cpuCount() const { return (int)m_cpus.size(); }
+    const std::vector<int>& cpus() const { return m_cpus; }
+    int numaNode() const { return m_node; }
+
+    /* binds the calling thread, saving its previous placement */
+    bool bind();
+    /* restores the placement saved by bind() */
+    void unbind();
+
+  private:
+    static const int MAX_NUMA_NODES = 1024;
+    bool m_active;
+    bool m_bound;
+    int m_node;
+    std::vector<int> m_cpus;
+    std::vector<int> m_savedCpus;
+    int m_savedPolicy;
+    unsigned long m_savedNodes[MAX_NUMA_NODES / (8 * sizeof(unsigned long))];
+  };
+
+  /* Threads created by a call to decVTM_create. libvtmdec does not give their
+   * ids: the creating thread takes a name of its own for the call, which the
+   * new threads inherit, and the threads of the process with this name are
+   * the group. Threads created meanwhile by other threads are not included.
+   * libvtmdec cannot resize its pool: restricting these threads to fewer cpus
+   * limits the cpus they use, not their number (they keep running, or
+   * spinning, on the remaining cpus). Only supported on Linux. */
+  class ThreadGroup
+  {
+  public:
+    ThreadGroup();
+
+    /* around the creation, on the creating thread */
+    void begin();
+    void end();
+    bool isEmpty() const { return m_tids.empty(); }
+    /* cpus the threads could run on when they were created, at most one per thread */
+    int cpuCount() const { return std::min((int)m_cpus.size(), (int)m_tids.size()); }
+    /* cpus they are restricted to */
+    int activeCount() const { return m_active; }
+
+    /* runs the threads on count of their cpus, one per core first (all of
+     * them: no restriction) */
+    bool restrict(int count);
+    /* gives the threads back the cpus they had when they were found */
+    void restore();
+
+  private:
+    std::vector<int> m_tids;
+    std::vector<std::vector<int> > m_savedCpus;
+    std::vector<int> m_cpus;  // one cpu of each core first, then the SMT siblings
+    int m_cores;
+    char m_savedName[16];
+    size_t m_offset;
+    int m_active;
+  };
+
+  struct cpu_info_t
+  {
+    int logicalCpus;    // cpus the threads may run on
+    int physicalCores;  // cores of these cpus, SMT siblings counted once
+    int quotaCpus;      // cgroup cpu quota rounded up, 0 if unlimited
+  };
+
+  /* cpus available to the decoder among the given ones (NULL: affinity of
+   * the calling thread). Linux only: returns false elsewhere */
+  bool GetCpuInfo(const std::vector<int>* cpus, cpu_info_t* info);
+
+  /* parses a cpulist ("0-3,8-11"), returns false on syntax error */
+  bool ParseCpuList(const char* psz_cpuList, std::vector<int>& cpus);
+
+  /* Share of the cores of a decoder, split between the decoders running in
+   * the process in proportion of their weight (picture size). A new decoder
+   * gets its fair share, or the threads left free if fewer. The pool of a VTM
+   * instance cannot be resized: the share of a resizable decoder (its threads
+   * were found, see ThreadGroup) goes down to the new fair share when a
+   * decoder joins and back up to its pool when one leaves, and the decoder
+   * restricts its threads to that many cpus while it is shared. A decoder
+   * running alone leaves its threads where they are. */
+  class ThreadShare
+  {
+  public:
+    ThreadShare();
+    ~ThreadShare();
+
+    /* returns the threads to create, at most totalThreads; decoders receives
+     * the number of decoders sharing the cores, this one included. The budget
+     * split between them is the largest totalThreads of the decoders
+     * registered since none was */
+    int acquire(int totalThreads, uint64_t weight, int* decoders);
+    void release();
+    bool isActive() const { return m_weight != 0; }
+    uint64_t weight() const { return m_weight; }
+    /* the threads can run on any count of cpus up to pool */
+    void setResizable(int pool);
+    /* threads this decoder may run now */
+    int threads() const { return m_threads; }
+    /* other decoders share the cores */
+    bool isShared() const { return m_shared; }
+    void setShared(bool b_shared) { m_shared = b_shared; }
+
+  private:
+    uint64_t m_weight;
+    int m_pool;
+    std::atomic<int> m_threads;
+    std::atomic<bool> m_shared;
+  };
+}
+
+#endif // VVC_CPU_H_
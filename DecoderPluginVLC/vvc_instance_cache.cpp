@@ -0,0 +1,97 @@
+/*****************************************************************************
+ * vvc_instance_cache.cpp: idle decoder instances reused across streams
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include "vvc_instance_cache.h"
+
+struct idle_instance_t
+{
+  VvcDecoder::instance_key_t key;
+  DecVTMInstance* decVtm;
+  VvcDecoder::ThreadGroup threads;
+};
+
+// most recently released first, never destroyed at exit: their threads would
+// have to be joined while the library is unloaded, the module is not unloaded
+static std::list<idle_instance_t> s_idleInstances;
+static std::mutex s_idleLock;
+
+bool VvcDecoder::instance_key_t::operator==(const instance_key_t& other) const
+{
+  return nbThreads == other.nbThreads && nbThreadsForParsing == other.nbThreadsForParsing &&
+    targetLayerSet == other.targetLayerSet && opt == other.opt && placement == other.placement;
+}
+
+DecVTMInstance* VvcDecoder::AcquireInstance(const instance_key_t& key, ThreadGroup* threads)
+{
+  std::lock_guard<std::mutex> lock(s_idleLock);
+  for (std::list<idle_instance_t>::iterator it = s_idleInstances.begin(); it != s_idleInstances.end(); ++it)
+  {
+    if (it->key == key)
+    {
+      DecVTMInstance* decVtm = it->decVtm;
+      *threads = it->threads;
+      s_idleInstances.erase(it);
+      return decVtm;
+    }
+  }
+  return NULL;
+}
+
+void VvcDecoder::ReleaseInstance(DecVTMInstance* decVtm, const ThreadGroup& threads, const instance_key_t& key, int maxIdle)
+{
+  // libvtmdec cannot reset: output and drop everything still in the decoder,
+  // the next stream starts at an IRAP like after a flush
+  decVTM_decode(decVtm, nullptr, 0, 0);
+  decVTM_flush(decVtm);
+  short* planes[3];
+  int strides[3];
+  int width, height, chromaFormat, bitDepths, layer, nbSkippedPictures;
+  while (decVTM_getNextOutputFrame(decVtm, true, planes, strides, &width, &height, &chromaFormat, &bitDepths, &layer, &nbSkippedPictures))
+  {
+    decVTM_setlastPicDisplayed(decVtm);
+  }
+
+  std::vector<DecVTMInstance*> evicted;
+  {
+    std::lock_guard<std::mutex> lock(s_idleLock);
+    s_idleInstances.push_front(idle_instance_t());
+    s_idleInstances.front().key = key;
+    s_idleInstances.front().decVtm = decVtm;
+    s_idleInstances.front().threads = threads;
+    while ((int)s_idleInstances.size() > maxIdle)
+    {
+      evicted.push_back(s_idleInstances.back().decVtm);
+      s_idleInstances.pop_back();
+    }
+  }
+  // destroying an instance joins its threads: not under the lock
+  for (DecVTMInstance* p : evicted)
+  {
+    decVTM_destroy(p);
+  }
+}
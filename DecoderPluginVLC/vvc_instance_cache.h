@@ -0,0 +1,58 @@
+/*****************************************************************************
+ * vvc_instance_cache.h: idle decoder instances reused across streams
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VVC_INSTANCE_CACHE_H_
+#define VVC_INSTANCE_CACHE_H_
+
+#include <string>
+
+#include "LibVTMDec.h"
+
+#include "vvc_cpu.h"
+
+namespace VvcDecoder
+{
+  /* Creation parameters of a libvtmdec instance: an idle instance is only
+   * reused by a decoder that would have created it the same way */
+  struct instance_key_t
+  {
+    int nbThreads;  // asked for, before the thread budget
+    int nbThreadsForParsing;
+    int targetLayerSet;
+    std::string opt;
+    std::string placement;  // the VTM threads keep the cpus they were created on
+
+    bool operator==(const instance_key_t& other) const;
+  };
+
+  /* Process-wide cache of idle instances, saving the thread pool and buffer
+   * setup of decVTM_create for consecutive streams (playlists, zapping).
+   * Returns NULL if no idle instance has this key, threads receives the
+   * threads of the instance found when it was created (empty if not). */
+  DecVTMInstance* AcquireInstance(const instance_key_t& key, ThreadGroup* threads);
+
+  /* Drains the instance and keeps it idle for a next stream, with its
+   * threads restored to their cpus. Above maxIdle idle instances, the least
+   * recently released ones are destroyed. */
+  void ReleaseInstance(DecVTMInstance* decVtm, const ThreadGroup& threads, const instance_key_t& key, int maxIdle);
+}
+
+#endif // VVC_INSTANCE_CACHE_H_
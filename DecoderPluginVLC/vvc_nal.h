@@ -22,6 +22,9 @@
 #ifndef __VVC_NAL_H__
 #define __VVC_NAL_H__
 
+#include <stdint.h>
+#include <stddef.h>
+
 enum vvc_nal_unit_type_e
 {
   VVC_NAL_CODED_SLICE_TRAIL = 0,   // 0
@@ -64,4 +67,263 @@ enum vvc_nal_unit_type_e
   VVC_NAL_INVALID
 };
 
+/* Private block flag from the packetizer to the decoder: in trick-play, the
+ * first IRAP after dropped access units, decoding starts over from it.
+ * BLOCK_FLAG_DISCONTINUITY is not used, the demux sets it too */
+#define VVC_BLOCK_FLAG_RESTART (1 << BLOCK_FLAG_PRIVATE_SHIFT)
+
+struct vvc_au_info_t
+{
+  vvc_nal_unit_type_e nalType;  // type of the first VCL NAL unit
+  int temporalId;
+  int layerId;
+  bool isIrap;                  // IDR, CRA or GDR: decoding can start here
+  bool isNonRef;                // ph_non_ref_pic_flag: not used as reference
+};
+
+/* Reads the first VCL NAL unit of an annexB access unit and its picture header,
+ * returns false if no VCL NAL unit was found */
+static inline bool vvc_getAUInfo(const uint8_t* p_buf, size_t i_buf, vvc_au_info_t* p_info)
+{
+  bool phNonRef = false;
+  bool phFound = false;
+  for (size_t i = 0; i + 5 < i_buf; i++)
+  {
+    if (p_buf[i] != 0 || p_buf[i + 1] != 0 || p_buf[i + 2] != 1)
+      continue;
+    const uint8_t* nal = p_buf + i + 3;
+    vvc_nal_unit_type_e type = (vvc_nal_unit_type_e)((nal[1] >> 3) & 0x1f);
+    if (type == VVC_NAL_PH)
+    {
+      // ph_gdr_or_irap_pic_flag, ph_non_ref_pic_flag
+      phNonRef = (nal[2] >> 6) & 0x1;
+      phFound = true;
+    }
+    else if (type <= VVC_NAL_RESERVED_IRAP_VCL_11)
+    {
+      p_info->nalType = type;
+      p_info->layerId = nal[0] & 0x3f;
+      p_info->temporalId = (nal[1] & 0x07) - 1;
+      p_info->isIrap = type >= VVC_NAL_CODED_SLICE_IDR_W_RADL && type <= VVC_NAL_CODED_SLICE_GDR;
+      // sh_picture_header_in_slice_header_flag, then ph_gdr_or_irap_pic_flag, ph_non_ref_pic_flag
+      if ((nal[2] >> 7) & 0x1)
+        p_info->isNonRef = (nal[2] >> 5) & 0x1;
+      else
+        p_info->isNonRef = phFound && phNonRef;
+      return true;
+    }
+    i += 2;
+  }
+  return false;
+}
+
+/* MSB-first reader of a NAL unit payload, emulation prevention bytes are skipped */
+struct vvc_bitreader_t
+{
+  const uint8_t* p;
+  const uint8_t* end;
+  int bitPos;       // next bit of *p, 7 is the msb
+  int zeros;        // zero bytes before p
+  bool overrun;
+};
+
+static inline void vvc_br_init(vvc_bitreader_t* br, const uint8_t* p, size_t size)
+{
+  br->p = p;
+  br->end = p + size;
+  br->bitPos = 7;
+  br->zeros = 0;
+  br->overrun = false;
+}
+
+static inline void vvc_br_nextByte(vvc_bitreader_t* br)
+{
+  br->zeros = *br->p ? 0 : br->zeros + 1;
+  br->p++;
+  br->bitPos = 7;
+  if (br->zeros >= 2 && br->p < br->end && *br->p == 0x03)
+  {
+    br->p++;
+    br->zeros = 0;
+  }
+}
+
+static inline uint32_t vvc_br_read(vvc_bitreader_t* br, int nbBits)
+{
+  uint32_t value = 0;
+  for (int i = 0; i < nbBits; i++)
+  {
+    if (br->p >= br->end)
+    {
+      br->overrun = true;
+      return 0;
+    }
+    value = (value << 1) | ((*br->p >> br->bitPos) & 1);
+    if (br->bitPos-- == 0)
+      vvc_br_nextByte(br);
+  }
+  return value;
+}
+
+static inline void vvc_br_skip(vvc_bitreader_t* br, uint32_t nbBits)
+{
+  for (; nbBits > 0 && !br->overrun; nbBits--)
+    vvc_br_read(br, 1);
+}
+
+static inline uint32_t vvc_br_read_ue(vvc_bitreader_t* br)
+{
+  int leadingZeros = 0;
+  while (!vvc_br_read(br, 1))
+  {
+    if (br->overrun || ++leadingZeros > 31)
+    {
+      br->overrun = true;
+      return 0;
+    }
+  }
+  return ((1u << leadingZeros) - 1) + vvc_br_read(br, leadingZeros);
+}
+
+static inline void vvc_br_align(vvc_bitreader_t* br)
+{
+  if (br->bitPos != 7 && br->p < br->end)
+    vvc_br_nextByte(br);
+}
+
+struct vvc_sps_dpb_t
+{
+  int spsId;
+  int maxDecPicBuffering;       // dpb_max_dec_pic_buffering_minus1 + 1 of the highest sub-layer
+  int maxNumReorderPics;        // dpb_max_num_reorder_pics of the highest sub-layer
+};
+
+/* Parses the DPB parameters of a SPS NAL unit (starting at its NAL header).
+ * Returns false if the SPS does not carry them (they are then in the VPS) */
+static inline bool vvc_parseSpsDpb(const uint8_t* p_nal, size_t i_nal, vvc_sps_dpb_t* p_dpb)
+{
+  vvc_bitreader_t br;
+  if (i_nal < 3)
+    return false;
+  vvc_br_init(&br, p_nal + 2, i_nal - 2);
+
+  p_dpb->spsId = (int)vvc_br_read(&br, 4);
+  vvc_br_skip(&br, 4);                                      // sps_video_parameter_set_id
+  const int maxSublayersMinus1 = (int)vvc_br_read(&br, 3);
+  vvc_br_skip(&br, 2);                                      // sps_chroma_format_idc
+  const int ctbLog2Size = (int)vvc_br_read(&br, 2) + 5;
+  if (!vvc_br_read(&br, 1))                                 // sps_ptl_dpb_hrd_params_present_flag
+    return false;
+
+  // profile_tier_level(1, sps_max_sublayers_minus1)
+  vvc_br_skip(&br, 7 + 1 + 8 + 1 + 1);                      // profile, tier, level, frame_only, multilayer
+  if (vvc_br_read(&br, 1))                                  // gci_present_flag
+  {
+    vvc_br_skip(&br, 71);                                   // constraint flags and idc
+    vvc_br_skip(&br, vvc_br_read(&br, 8));                  // gci_num_additional_bits
+  }
+  vvc_br_align(&br);
+  int sublayerLevelPresent = 0;
+  for (int i = maxSublayersMinus1 - 1; i >= 0; i--)
+    sublayerLevelPresent += (int)vvc_br_read(&br, 1);
+  vvc_br_align(&br);
+  vvc_br_skip(&br, 8 * sublayerLevelPresent);               // sublayer_level_idc
+  vvc_br_skip(&br, 32 * vvc_br_read(&br, 8));               // general_sub_profile_idc
+
+  vvc_br_skip(&br, 1);                                      // sps_gdr_enabled_flag
+  if (vvc_br_read(&br, 1))                                  // sps_ref_pic_resampling_enabled_flag
+    vvc_br_skip(&br, 1);                                    // sps_res_change_in_clvs_allowed_flag
+  const uint32_t width = vvc_br_read_ue(&br);
+  const uint32_t height = vvc_br_read_ue(&br);
+  if (vvc_br_read(&br, 1))                                  // sps_conformance_window_flag
+  {
+    for (int i = 0; i < 4; i++)
+      vvc_br_read_ue(&br);
+  }
+  if (vvc_br_read(&br, 1))                                  // sps_subpic_info_present_flag
+  {
+    const uint32_t numSubpicsMinus1 = vvc_br_read_ue(&br);
+    bool independent = true;
+    bool sameSize = false;
+    if (numSubpicsMinus1 > 0)
+    {
+      independent = vvc_br_read(&br, 1);
+      sameSize = vvc_br_read(&br, 1);
+    }
+    const uint32_t ctbSize = 1u << ctbLog2Size;
+    int xBits = 0, yBits = 0;
+    while ((1u << xBits) < (width + ctbSize - 1) / ctbSize)
+      xBits++;
+    while ((1u << yBits) < (height + ctbSize - 1) / ctbSize)
+      yBits++;
+    for (uint32_t i = 0; numSubpicsMinus1 > 0 && i <= numSubpicsMinus1 && !br.overrun; i++)
+    {
+      if (!sameSize || i == 0)
+      {
+        if (i > 0 && width > ctbSize)
+          vvc_br_skip(&br, xBits);
+        if (i > 0 && height > ctbSize)
+          vvc_br_skip(&br, yBits);
+        if (i < numSubpicsMinus1 && width > ctbSize)
+          vvc_br_skip(&br, xBits);
+        if (i < numSubpicsMinus1 && height > ctbSize)
+          vvc_br_skip(&br, yBits);
+      }
+      if (!independent)
+        vvc_br_skip(&br, 2);
+    }
+    const uint32_t idLen = vvc_br_read_ue(&br) + 1;
+    if (vvc_br_read(&br, 1) && vvc_br_read(&br, 1))         // explicitly signalled, present in the SPS
+      vvc_br_skip(&br, idLen * (numSubpicsMinus1 + 1));
+  }
+  vvc_br_read_ue(&br);                                      // sps_bitdepth_minus8
+  vvc_br_skip(&br, 1 + 1 + 4);                              // wpp, entry points, poc lsb
+  if (vvc_br_read(&br, 1))                                  // sps_poc_msb_cycle_flag
+    vvc_br_read_ue(&br);
+  vvc_br_skip(&br, 8 * vvc_br_read(&br, 2));                // sps_num_extra_ph_bytes, sps_extra_ph_bit_present_flag
+  vvc_br_skip(&br, 8 * vvc_br_read(&br, 2));                // sps_num_extra_sh_bytes, sps_extra_sh_bit_present_flag
+
+  // dpb_parameters(sps_max_sublayers_minus1, sps_sublayer_dpb_params_flag)
+  const bool sublayerDpb = maxSublayersMinus1 > 0 && vvc_br_read(&br, 1);
+  for (int i = sublayerDpb ? 0 : maxSublayersMinus1; i <= maxSublayersMinus1; i++)
+  {
+    p_dpb->maxDecPicBuffering = (int)vvc_br_read_ue(&br) + 1;
+    p_dpb->maxNumReorderPics = (int)vvc_br_read_ue(&br);
+    vvc_br_read_ue(&br);                                    // dpb_max_latency_increase_plus1
+  }
+  return !br.overrun;
+}
+
+/* DPB parameters of the last SPS before the first VCL NAL unit of an annexB access unit */
+static inline bool vvc_getSpsDpb(const uint8_t* p_buf, size_t i_buf, vvc_sps_dpb_t* p_dpb)
+{
+  bool found = false;
+  for (size_t i = 0; i + 5 < i_buf; i++)
+  {
+    if (p_buf[i] != 0 || p_buf[i + 1] != 0 || p_buf[i + 2] != 1)
+      continue;
+    const uint8_t* nal = p_buf + i + 3;
+    vvc_nal_unit_type_e type = (vvc_nal_unit_type_e)((nal[1] >> 3) & 0x1f);
+    if (type <= VVC_NAL_RESERVED_IRAP_VCL_11)
+      break;
+    if (type == VVC_NAL_SPS)
+    {
+      // the SPS ends at the next start code (trailing zero bytes included, they are not parsed)
+      size_t end = i + 3;
+      while (end + 2 < i_buf && (p_buf[end] != 0 || p_buf[end + 1] != 0 || p_buf[end + 2] != 1))
+        end++;
+      if (end + 2 >= i_buf)
+        end = i_buf;
+      vvc_sps_dpb_t dpb;
+      if (vvc_parseSpsDpb(nal, p_buf + end - nal, &dpb))
+      {
+        *p_dpb = dpb;
+        found = true;
+      }
+    }
+    i += 2;
+  }
+  return found;
+}
+
 #endif // __VVC_NAL_H__
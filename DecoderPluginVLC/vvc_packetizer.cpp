@@ -90,6 +90,12 @@ struct decoder_sys_t
     bool gotSps;
     bool gotPps;
     int baseLayerID;
+
+    /* trick-play: only IRAP access units are output */
+    float trickplayRate;
+    bool b_trickplay;
+    bool b_frame_irap;
+    bool b_dropped;
 };
 
 static const uint8_t p_vcc_startcode[3] = { 0x00, 0x00, 0x01};
@@ -111,7 +117,8 @@ static block_t * OutputQueues(decoder_sys_t *p_sys, bool b_valid)
 
     if (p_sys->frame.p_chain)
     {
-      i_flags |= p_sys->frame.p_chain->i_flags;
+      // the private flags of the input are not ours
+      i_flags |= p_sys->frame.p_chain->i_flags & ~BLOCK_FLAG_PRIVATE_MASK;
       block_ChainLastAppend(&pp_output_last, p_sys->frame.p_chain);
 
       mtime_t dts = VLC_TS_INVALID, pts = VLC_TS_INVALID;
@@ -153,7 +160,19 @@ static block_t * OutputQueues(decoder_sys_t *p_sys, bool b_valid)
         p_output->i_flags |= i_flags;
         if(!b_valid)
             p_output->i_flags |= BLOCK_FLAG_DROP;
+        if(p_sys->b_trickplay && !p_sys->b_frame_irap)
+        {
+            p_output->i_flags |= BLOCK_FLAG_DROP;
+            p_sys->b_dropped = true;
+        }
+        else if(p_sys->b_dropped && p_sys->b_frame_irap)
+        {
+            /* tells the decoder to start over from this IRAP */
+            p_output->i_flags |= VVC_BLOCK_FLAG_RESTART;
+            p_sys->b_dropped = false;
+        }
     }
+    p_sys->b_frame_irap = false;
 
     return p_output;
 }
@@ -197,6 +216,10 @@ int VvcDecoder::OpenPack(vlc_object_t *p_this)
     p_sys->b_init_sequence_complete  = false;
     p_sys->i_nb_frames = 0;
     p_sys->baseLayerID = -1;
+    p_sys->trickplayRate = var_InheritFloat(p_dec, "vvc-trickplay-rate");
+    p_sys->b_trickplay = false;
+    p_sys->b_frame_irap = false;
+    p_sys->b_dropped = false;
 
     packetizer_t* p_pack = &p_dec->p_sys->packetizer;
     p_pack->i_state = STATE_NOSYNC;
@@ -308,6 +331,21 @@ static void PacketizeFlush( decoder_t *p_dec )
 /****************************************************************************
  * Packetizer Helpers
  ****************************************************************************/
+static void UpdateTrickPlay(decoder_t *p_dec)
+{
+    decoder_sys_t *p_sys = p_dec->p_sys;
+    /* playback rate of the input */
+    const bool b_trickplay = var_InheritFloat(p_dec, "rate") >= p_sys->trickplayRate;
+    if (b_trickplay == p_sys->b_trickplay)
+        return;
+    /* back to normal playback at an IRAP only: the dropped pictures are not
+     * available as references */
+    if (!b_trickplay && !p_sys->b_frame_irap)
+        return;
+    msg_Dbg(p_dec, "%s irap-only output", b_trickplay ? "start" : "end");
+    p_sys->b_trickplay = b_trickplay;
+}
+
 static void PacketizeReset(void *p_private, bool b_broken)
 {
     VLC_UNUSED(b_broken);
@@ -334,6 +372,7 @@ static void PacketizeReset(void *p_private, bool b_broken)
     p_sys->gotPps = false;
     p_sys->gotSps = false;
     p_sys->i_nb_frames = 0;
+    p_sys->b_frame_irap = false;
     date_Set(&p_sys->dts, VLC_TS_INVALID);
     p_sys->pts = VLC_TS_INVALID;
     p_sys->b_need_ts = true;
@@ -433,6 +472,7 @@ static block_t *ParseNALBlock(decoder_t *p_dec, bool *pb_ts_used, block_t *p_fra
     bool isNewPicture = false;
     bool currentIsFirstSlice = false;
     bool maybeNew = false;
+    bool isIrap = false;
     switch (i_nal_type)//nalu.m_nalUnitType)
     {
       // NUT that indicate the start of a new picture
@@ -459,6 +499,8 @@ static block_t *ParseNALBlock(decoder_t *p_dec, bool *pb_ts_used, block_t *p_fra
     case VVC_NAL_RESERVED_VCL_5:
     case VVC_NAL_RESERVED_VCL_6:
     case VVC_NAL_RESERVED_IRAP_VCL_11:
+      isIrap = i_nal_type == VVC_NAL_CODED_SLICE_IDR_W_RADL || i_nal_type == VVC_NAL_CODED_SLICE_IDR_N_LP
+        || i_nal_type == VVC_NAL_CODED_SLICE_CRA || i_nal_type == VVC_NAL_CODED_SLICE_GDR;
       p_frag->i_flags |= BLOCK_FLAG_TYPE_P;
       // checkPictureHeaderInSliceHeaderFlag
       currentIsFirstSlice = ((p_frag->p_buffer[6] >> 7) & 0x1) || !p_sys->sliceInPicture;
@@ -508,10 +550,14 @@ static block_t *ParseNALBlock(decoder_t *p_dec, bool *pb_ts_used, block_t *p_fra
           p_sys->pts = pts;
         }
         *pb_ts_used = true;
+        if (p_sys->trickplayRate > 0.f)
+          UpdateTrickPlay(p_dec);
         p_output = OutputQueues(p_sys, p_sys->b_init_sequence_complete);
       }
       p_sys->sliceInPicture = currentIsFirstSlice;
     }
+    if (isIrap)
+      p_sys->b_frame_irap = true;
     p_sys->lastTid = i_nal_temporal_ID;
     if (maybeNew)
     {
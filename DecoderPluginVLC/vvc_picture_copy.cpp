@@ -0,0 +1,1015 @@
+/*****************************************************************************
+ * vvc_picture_copy.cpp: copy of VTM output planes into vlc pictures
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+/*****************************************************************************
+ * Preamble
+ *****************************************************************************/
+#if defined(_MSC_VER)
+#define NOMINMAX
+#include <basetsd.h>
+typedef SSIZE_T ssize_t;
+#endif
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <vlc_common.h>
+#include <vlc_cpu.h>
+
+#include <string.h>
+#include <algorithm>
+
+#include "vvc_picture_copy.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+# define VVC_COPY_X86 1
+# include <immintrin.h>
+# if defined(__GNUC__) || defined(__clang__)
+#  define VVC_TARGET_SSE4_1 __attribute__((target("sse4.1")))
+#  define VVC_TARGET_AVX2   __attribute__((target("avx2")))
+# else
+#  define VVC_TARGET_SSE4_1
+#  define VVC_TARGET_AVX2
+# endif
+#endif
+
+/*****************************************************************************
+ * C version
+ *****************************************************************************/
+static void CopyPlaneNarrow_C(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, int i_src_stride, int width, int lines)
+{
+  for (int y = 0; y < lines; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      p_dst[x] = (uint8_t)p_src[x];
+    }
+    p_dst += i_dst_pitch;
+    p_src += i_src_stride;
+  }
+}
+
+static void CopyPlane_C(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, int i_src_stride, int width, int lines)
+{
+  if (i_dst_pitch == i_src_stride * (int)sizeof(short) && width == i_dst_pitch)
+  {
+    memcpy(p_dst, p_src, (size_t)width * lines);
+    return;
+  }
+  for (int y = 0; y < lines; y++)
+  {
+    memcpy(p_dst, p_src, width);
+    p_dst += i_dst_pitch;
+    p_src += i_src_stride;
+  }
+}
+
+static void CopyPlaneShift_C(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, int i_src_stride, int width, int lines, int shift)
+{
+  for (int y = 0; y < lines; y++)
+  {
+    uint16_t* dst = (uint16_t*)p_dst;
+    for (int x = 0; x < width; x++)
+    {
+      dst[x] = (uint16_t)(p_src[x] << shift);
+    }
+    p_dst += i_dst_pitch;
+    p_src += i_src_stride;
+  }
+}
+
+static void InterleavePlaneNarrow_C(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src_u, const short* p_src_v, int i_src_stride, int width, int lines)
+{
+  for (int y = 0; y < lines; y++)
+  {
+    for (int x = 0; x < width; x++)
+    {
+      p_dst[2 * x] = (uint8_t)p_src_u[x];
+      p_dst[2 * x + 1] = (uint8_t)p_src_v[x];
+    }
+    p_dst += i_dst_pitch;
+    p_src_u += i_src_stride;
+    p_src_v += i_src_stride;
+  }
+}
+
+static void InterleavePlane_C(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src_u, const short* p_src_v, int i_src_stride, int width, int lines, int shift)
+{
+  for (int y = 0; y < lines; y++)
+  {
+    uint16_t* dst = (uint16_t*)p_dst;
+    for (int x = 0; x < width; x++)
+    {
+      dst[2 * x] = (uint16_t)(p_src_u[x] << shift);
+      dst[2 * x + 1] = (uint16_t)(p_src_v[x] << shift);
+    }
+    p_dst += i_dst_pitch;
+    p_src_u += i_src_stride;
+    p_src_v += i_src_stride;
+  }
+}
+/*****************************************************************************
+ * Ordered dithering to 8 bits: 8x8 Bayer thresholds scaled to the dropped bits
+ *****************************************************************************/
+static const uint8_t bayer8x8[8][8] = {
+  {  0, 32,  8, 40,  2, 34, 10, 42 },
+  { 48, 16, 56, 24, 50, 18, 58, 26 },
+  { 12, 44,  4, 36, 14, 46,  6, 38 },
+  { 60, 28, 52, 20, 62, 30, 54, 22 },
+  {  3, 35, 11, 43,  1, 33,  9, 41 },
+  { 51, 19, 59, 27, 49, 17, 57, 25 },
+  { 15, 47,  7, 39, 13, 45,  5, 37 },
+  { 63, 31, 55, 23, 61, 29, 53, 21 },
+};
+
+/* rows are repeated twice so that 16 thresholds can be loaded at once */
+static void InitDither(int16_t dither[8][16], int shift)
+{
+  for (int y = 0; y < 8; y++)
+  {
+    for (int x = 0; x < 16; x++)
+    {
+      dither[y][x] = (int16_t)((bayer8x8[y][x & 7] << shift) >> 6);
+    }
+  }
+}
+
+static inline uint8_t DitherSample(short value, int16_t threshold, int shift)
+{
+  const int v = (value + threshold) >> shift;
+  return (uint8_t)(v > 255 ? 255 : v);
+}
+
+static void CopyPlaneDither_C(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, int i_src_stride, int width, int lines, int shift)
+{
+  int16_t dither[8][16];
+  InitDither(dither, shift);
+  for (int y = 0; y < lines; y++)
+  {
+    const int16_t* d = dither[y & 7];
+    for (int x = 0; x < width; x++)
+    {
+      p_dst[x] = DitherSample(p_src[x], d[x & 7], shift);
+    }
+    p_dst += i_dst_pitch;
+    p_src += i_src_stride;
+  }
+}
+
+/* Cb and Cr use the same thresholds, like the planar copy */
+static void InterleavePlaneDither_C(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src_u, const short* p_src_v, int i_src_stride, int width, int lines, int shift)
+{
+  int16_t dither[8][16];
+  InitDither(dither, shift);
+  for (int y = 0; y < lines; y++)
+  {
+    const int16_t* d = dither[y & 7];
+    for (int x = 0; x < width; x++)
+    {
+      p_dst[2 * x] = DitherSample(p_src_u[x], d[x & 7], shift);
+      p_dst[2 * x + 1] = DitherSample(p_src_v[x], d[x & 7], shift);
+    }
+    p_dst += i_dst_pitch;
+    p_src_u += i_src_stride;
+    p_src_v += i_src_stride;
+  }
+}
+
+/*****************************************************************************
+ * Box filter downscale: the sums of up to 4x4 12-bit samples fit in 16 bits
+ *****************************************************************************/
+/* one output row from column x, thresholds being the dither row */
+static void DownscaleRow_C(uint8_t* p_dst, const short* p_src, const short* p_src_v, int i_src_stride,
+  int x, int width, int log2Factor, int sampleSize, int shift, const int16_t* thresholds)
+{
+  const int factor = 1 << log2Factor;
+  const int round = 1 << (2 * log2Factor - 1);
+  const int components = p_src_v ? 2 : 1;
+  for (int c = 0; c < components; c++)
+  {
+    const short* p_plane = c ? p_src_v : p_src;
+    for (int i = x; i < width; i++)
+    {
+      const short* src = p_plane + i * factor;
+      int sum = 0;
+      for (int j = 0; j < factor; j++)
+      {
+        for (int k = 0; k < factor; k++)
+        {
+          sum += src[k];
+        }
+        src += i_src_stride;
+      }
+      const int value = (sum + round) >> (2 * log2Factor);
+      if (sampleSize == 2)
+        ((uint16_t*)p_dst)[components * i + c] = (uint16_t)(value << shift);
+      else
+        p_dst[components * i + c] = DitherSample((short)value, thresholds[i & 7], shift);
+    }
+  }
+}
+
+static void DownscalePlane_C(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, const short* p_src_v, int i_src_stride, int width, int lines,
+  int log2Factor, int sampleSize, int shift)
+{
+  int16_t dither[8][16];
+  InitDither(dither, sampleSize == 1 ? shift : 0);
+  const int srcStep = i_src_stride << log2Factor;
+  for (int y = 0; y < lines; y++)
+  {
+    DownscaleRow_C(p_dst, p_src, p_src_v, i_src_stride, 0, width, log2Factor, sampleSize, shift, dither[y & 7]);
+    p_dst += i_dst_pitch;
+    p_src += srcStep;
+    if (p_src_v)
+      p_src_v += srcStep;
+  }
+}
+
+#ifdef VVC_COPY_X86
+/*****************************************************************************
+ * SSE4.1 version of the 16-bit copy
+ *****************************************************************************/
+VVC_TARGET_SSE4_1
+static void CopyPlaneStream_SSE4_1(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, int i_src_stride, int width, int lines)
+{
+  for (int y = 0; y < lines; y++)
+  {
+    const uint8_t* src = (const uint8_t*)p_src;
+    int x = 0;
+    // align the destination for the streaming stores
+    const int head = std::min(width, (int)((16 - ((uintptr_t)p_dst & 15)) & 15));
+    memcpy(p_dst, src, head);
+    x = head;
+    for (; x + 64 <= width; x += 64)
+    {
+      __m128i a = _mm_loadu_si128((const __m128i*)(src + x));
+      __m128i b = _mm_loadu_si128((const __m128i*)(src + x + 16));
+      __m128i c = _mm_loadu_si128((const __m128i*)(src + x + 32));
+      __m128i d = _mm_loadu_si128((const __m128i*)(src + x + 48));
+      _mm_stream_si128((__m128i*)(p_dst + x), a);
+      _mm_stream_si128((__m128i*)(p_dst + x + 16), b);
+      _mm_stream_si128((__m128i*)(p_dst + x + 32), c);
+      _mm_stream_si128((__m128i*)(p_dst + x + 48), d);
+    }
+    for (; x + 16 <= width; x += 16)
+    {
+      _mm_stream_si128((__m128i*)(p_dst + x), _mm_loadu_si128((const __m128i*)(src + x)));
+    }
+    memcpy(p_dst + x, src + x, width - x);
+    p_dst += i_dst_pitch;
+    p_src += i_src_stride;
+  }
+  _mm_sfence();
+}
+
+VVC_TARGET_SSE4_1
+static void CopyPlane_SSE4_1(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, int i_src_stride, int width, int lines)
+{
+  if ((size_t)width * lines < VvcDecoder::STREAM_COPY_MIN_SIZE)
+    CopyPlane_C(p_dst, i_dst_pitch, p_src, i_src_stride, width, lines);
+  else
+    CopyPlaneStream_SSE4_1(p_dst, i_dst_pitch, p_src, i_src_stride, width, lines);
+}
+
+/*****************************************************************************
+ * SSE4.1 version: 16 samples per iteration
+ *****************************************************************************/
+VVC_TARGET_SSE4_1
+static void CopyPlaneNarrow_SSE4_1(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, int i_src_stride, int width, int lines)
+{
+  const int width16 = width & ~15;
+  for (int y = 0; y < lines; y++)
+  {
+    int x = 0;
+    for (; x < width16; x += 16)
+    {
+      __m128i lo = _mm_loadu_si128((const __m128i*)(p_src + x));
+      __m128i hi = _mm_loadu_si128((const __m128i*)(p_src + x + 8));
+      _mm_storeu_si128((__m128i*)(p_dst + x), _mm_packus_epi16(lo, hi));
+    }
+    for (; x < width; x++)
+    {
+      p_dst[x] = (uint8_t)p_src[x];
+    }
+    p_dst += i_dst_pitch;
+    p_src += i_src_stride;
+  }
+}
+
+/*****************************************************************************
+ * AVX2 version: 32 samples per iteration
+ *****************************************************************************/
+VVC_TARGET_AVX2
+static void CopyPlaneNarrow_AVX2(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, int i_src_stride, int width, int lines)
+{
+  const int width32 = width & ~31;
+  for (int y = 0; y < lines; y++)
+  {
+    int x = 0;
+    for (; x < width32; x += 32)
+    {
+      __m256i lo = _mm256_loadu_si256((const __m256i*)(p_src + x));
+      __m256i hi = _mm256_loadu_si256((const __m256i*)(p_src + x + 16));
+      // packus works per 128-bit lane: restore sample order across lanes
+      __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+      _mm256_storeu_si256((__m256i*)(p_dst + x), packed);
+    }
+    if (x + 16 <= width)
+    {
+      __m128i lo = _mm_loadu_si128((const __m128i*)(p_src + x));
+      __m128i hi = _mm_loadu_si128((const __m128i*)(p_src + x + 8));
+      _mm_storeu_si128((__m128i*)(p_dst + x), _mm_packus_epi16(lo, hi));
+      x += 16;
+    }
+    for (; x < width; x++)
+    {
+      p_dst[x] = (uint8_t)p_src[x];
+    }
+    p_dst += i_dst_pitch;
+    p_src += i_src_stride;
+  }
+}
+
+/*****************************************************************************
+ * SSE4.1 versions of the shifted copy and of the chroma interleave
+ *****************************************************************************/
+VVC_TARGET_SSE4_1
+static void CopyPlaneShift_SSE4_1(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, int i_src_stride, int width, int lines, int shift)
+{
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  const int width8 = width & ~7;
+  for (int y = 0; y < lines; y++)
+  {
+    uint16_t* dst = (uint16_t*)p_dst;
+    int x = 0;
+    for (; x < width8; x += 8)
+    {
+      __m128i a = _mm_loadu_si128((const __m128i*)(p_src + x));
+      _mm_storeu_si128((__m128i*)(dst + x), _mm_sll_epi16(a, count));
+    }
+    for (; x < width; x++)
+    {
+      dst[x] = (uint16_t)(p_src[x] << shift);
+    }
+    p_dst += i_dst_pitch;
+    p_src += i_src_stride;
+  }
+}
+
+VVC_TARGET_SSE4_1
+static void InterleavePlaneNarrow_SSE4_1(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src_u, const short* p_src_v, int i_src_stride, int width, int lines)
+{
+  const int width8 = width & ~7;
+  for (int y = 0; y < lines; y++)
+  {
+    int x = 0;
+    for (; x < width8; x += 8)
+    {
+      __m128i u = _mm_loadu_si128((const __m128i*)(p_src_u + x));
+      __m128i v = _mm_loadu_si128((const __m128i*)(p_src_v + x));
+      __m128i uv = _mm_packus_epi16(_mm_unpacklo_epi16(u, v), _mm_unpackhi_epi16(u, v));
+      _mm_storeu_si128((__m128i*)(p_dst + 2 * x), uv);
+    }
+    for (; x < width; x++)
+    {
+      p_dst[2 * x] = (uint8_t)p_src_u[x];
+      p_dst[2 * x + 1] = (uint8_t)p_src_v[x];
+    }
+    p_dst += i_dst_pitch;
+    p_src_u += i_src_stride;
+    p_src_v += i_src_stride;
+  }
+}
+
+VVC_TARGET_SSE4_1
+static void InterleavePlane_SSE4_1(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src_u, const short* p_src_v, int i_src_stride, int width, int lines, int shift)
+{
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  const int width8 = width & ~7;
+  for (int y = 0; y < lines; y++)
+  {
+    uint16_t* dst = (uint16_t*)p_dst;
+    int x = 0;
+    for (; x < width8; x += 8)
+    {
+      __m128i u = _mm_sll_epi16(_mm_loadu_si128((const __m128i*)(p_src_u + x)), count);
+      __m128i v = _mm_sll_epi16(_mm_loadu_si128((const __m128i*)(p_src_v + x)), count);
+      _mm_storeu_si128((__m128i*)(dst + 2 * x), _mm_unpacklo_epi16(u, v));
+      _mm_storeu_si128((__m128i*)(dst + 2 * x + 8), _mm_unpackhi_epi16(u, v));
+    }
+    for (; x < width; x++)
+    {
+      dst[2 * x] = (uint16_t)(p_src_u[x] << shift);
+      dst[2 * x + 1] = (uint16_t)(p_src_v[x] << shift);
+    }
+    p_dst += i_dst_pitch;
+    p_src_u += i_src_stride;
+    p_src_v += i_src_stride;
+  }
+}
+
+/*****************************************************************************
+ * AVX2 versions of the shifted copy and of the chroma interleave
+ *****************************************************************************/
+VVC_TARGET_AVX2
+static void CopyPlaneShift_AVX2(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, int i_src_stride, int width, int lines, int shift)
+{
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  const int width16 = width & ~15;
+  for (int y = 0; y < lines; y++)
+  {
+    uint16_t* dst = (uint16_t*)p_dst;
+    int x = 0;
+    for (; x < width16; x += 16)
+    {
+      __m256i a = _mm256_loadu_si256((const __m256i*)(p_src + x));
+      _mm256_storeu_si256((__m256i*)(dst + x), _mm256_sll_epi16(a, count));
+    }
+    for (; x < width; x++)
+    {
+      dst[x] = (uint16_t)(p_src[x] << shift);
+    }
+    p_dst += i_dst_pitch;
+    p_src += i_src_stride;
+  }
+}
+
+VVC_TARGET_AVX2
+static void InterleavePlaneNarrow_AVX2(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src_u, const short* p_src_v, int i_src_stride, int width, int lines)
+{
+  const int width16 = width & ~15;
+  for (int y = 0; y < lines; y++)
+  {
+    int x = 0;
+    for (; x < width16; x += 16)
+    {
+      __m256i u = _mm256_loadu_si256((const __m256i*)(p_src_u + x));
+      __m256i v = _mm256_loadu_si256((const __m256i*)(p_src_v + x));
+      // unpack and packus both work per 128-bit lane: the bytes end up in order
+      __m256i uv = _mm256_packus_epi16(_mm256_unpacklo_epi16(u, v), _mm256_unpackhi_epi16(u, v));
+      _mm256_storeu_si256((__m256i*)(p_dst + 2 * x), uv);
+    }
+    for (; x < width; x++)
+    {
+      p_dst[2 * x] = (uint8_t)p_src_u[x];
+      p_dst[2 * x + 1] = (uint8_t)p_src_v[x];
+    }
+    p_dst += i_dst_pitch;
+    p_src_u += i_src_stride;
+    p_src_v += i_src_stride;
+  }
+}
+
+VVC_TARGET_AVX2
+static void InterleavePlane_AVX2(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src_u, const short* p_src_v, int i_src_stride, int width, int lines, int shift)
+{
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  const int width16 = width & ~15;
+  for (int y = 0; y < lines; y++)
+  {
+    uint16_t* dst = (uint16_t*)p_dst;
+    int x = 0;
+    for (; x < width16; x += 16)
+    {
+      __m256i u = _mm256_sll_epi16(_mm256_loadu_si256((const __m256i*)(p_src_u + x)), count);
+      __m256i v = _mm256_sll_epi16(_mm256_loadu_si256((const __m256i*)(p_src_v + x)), count);
+      __m256i lo = _mm256_unpacklo_epi16(u, v);
+      __m256i hi = _mm256_unpackhi_epi16(u, v);
+      _mm256_storeu_si256((__m256i*)(dst + 2 * x), _mm256_permute2x128_si256(lo, hi, 0x20));
+      _mm256_storeu_si256((__m256i*)(dst + 2 * x + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+    }
+    for (; x < width; x++)
+    {
+      dst[2 * x] = (uint16_t)(p_src_u[x] << shift);
+      dst[2 * x + 1] = (uint16_t)(p_src_v[x] << shift);
+    }
+    p_dst += i_dst_pitch;
+    p_src_u += i_src_stride;
+    p_src_v += i_src_stride;
+  }
+}
+
+/*****************************************************************************
+ * SSE4.1 versions of the dithered copy and interleave
+ *****************************************************************************/
+VVC_TARGET_SSE4_1
+static void CopyPlaneDither_SSE4_1(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, int i_src_stride, int width, int lines, int shift)
+{
+  int16_t dither[8][16];
+  InitDither(dither, shift);
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  const int width16 = width & ~15;
+  for (int y = 0; y < lines; y++)
+  {
+    const int16_t* d = dither[y & 7];
+    const __m128i thresholds = _mm_loadu_si128((const __m128i*)d);
+    int x = 0;
+    for (; x < width16; x += 16)
+    {
+      __m128i lo = _mm_loadu_si128((const __m128i*)(p_src + x));
+      __m128i hi = _mm_loadu_si128((const __m128i*)(p_src + x + 8));
+      lo = _mm_srl_epi16(_mm_add_epi16(lo, thresholds), count);
+      hi = _mm_srl_epi16(_mm_add_epi16(hi, thresholds), count);
+      _mm_storeu_si128((__m128i*)(p_dst + x), _mm_packus_epi16(lo, hi));
+    }
+    for (; x < width; x++)
+    {
+      p_dst[x] = DitherSample(p_src[x], d[x & 7], shift);
+    }
+    p_dst += i_dst_pitch;
+    p_src += i_src_stride;
+  }
+}
+
+VVC_TARGET_SSE4_1
+static void InterleavePlaneDither_SSE4_1(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src_u, const short* p_src_v, int i_src_stride, int width, int lines, int shift)
+{
+  int16_t dither[8][16];
+  InitDither(dither, shift);
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  const int width8 = width & ~7;
+  for (int y = 0; y < lines; y++)
+  {
+    const int16_t* d = dither[y & 7];
+    const __m128i thresholds = _mm_loadu_si128((const __m128i*)d);
+    int x = 0;
+    for (; x < width8; x += 8)
+    {
+      __m128i u = _mm_loadu_si128((const __m128i*)(p_src_u + x));
+      __m128i v = _mm_loadu_si128((const __m128i*)(p_src_v + x));
+      u = _mm_srl_epi16(_mm_add_epi16(u, thresholds), count);
+      v = _mm_srl_epi16(_mm_add_epi16(v, thresholds), count);
+      __m128i uv = _mm_packus_epi16(_mm_unpacklo_epi16(u, v), _mm_unpackhi_epi16(u, v));
+      _mm_storeu_si128((__m128i*)(p_dst + 2 * x), uv);
+    }
+    for (; x < width; x++)
+    {
+      p_dst[2 * x] = DitherSample(p_src_u[x], d[x & 7], shift);
+      p_dst[2 * x + 1] = DitherSample(p_src_v[x], d[x & 7], shift);
+    }
+    p_dst += i_dst_pitch;
+    p_src_u += i_src_stride;
+    p_src_v += i_src_stride;
+  }
+}
+
+/*****************************************************************************
+ * AVX2 versions of the dithered copy and interleave
+ *****************************************************************************/
+VVC_TARGET_AVX2
+static void CopyPlaneDither_AVX2(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, int i_src_stride, int width, int lines, int shift)
+{
+  int16_t dither[8][16];
+  InitDither(dither, shift);
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  const int width32 = width & ~31;
+  for (int y = 0; y < lines; y++)
+  {
+    const int16_t* d = dither[y & 7];
+    const __m256i thresholds = _mm256_loadu_si256((const __m256i*)d);
+    int x = 0;
+    for (; x < width32; x += 32)
+    {
+      __m256i lo = _mm256_loadu_si256((const __m256i*)(p_src + x));
+      __m256i hi = _mm256_loadu_si256((const __m256i*)(p_src + x + 16));
+      lo = _mm256_srl_epi16(_mm256_add_epi16(lo, thresholds), count);
+      hi = _mm256_srl_epi16(_mm256_add_epi16(hi, thresholds), count);
+      // packus works per 128-bit lane: restore sample order across lanes
+      __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(lo, hi), 0xD8);
+      _mm256_storeu_si256((__m256i*)(p_dst + x), packed);
+    }
+    for (; x < width; x++)
+    {
+      p_dst[x] = DitherSample(p_src[x], d[x & 7], shift);
+    }
+    p_dst += i_dst_pitch;
+    p_src += i_src_stride;
+  }
+}
+
+VVC_TARGET_AVX2
+static void InterleavePlaneDither_AVX2(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src_u, const short* p_src_v, int i_src_stride, int width, int lines, int shift)
+{
+  int16_t dither[8][16];
+  InitDither(dither, shift);
+  const __m128i count = _mm_cvtsi32_si128(shift);
+  const int width16 = width & ~15;
+  for (int y = 0; y < lines; y++)
+  {
+    const int16_t* d = dither[y & 7];
+    const __m256i thresholds = _mm256_loadu_si256((const __m256i*)d);
+    int x = 0;
+    for (; x < width16; x += 16)
+    {
+      __m256i u = _mm256_loadu_si256((const __m256i*)(p_src_u + x));
+      __m256i v = _mm256_loadu_si256((const __m256i*)(p_src_v + x));
+      u = _mm256_srl_epi16(_mm256_add_epi16(u, thresholds), count);
+      v = _mm256_srl_epi16(_mm256_add_epi16(v, thresholds), count);
+      __m256i uv = _mm256_packus_epi16(_mm256_unpacklo_epi16(u, v), _mm256_unpackhi_epi16(u, v));
+      _mm256_storeu_si256((__m256i*)(p_dst + 2 * x), uv);
+    }
+    for (; x < width; x++)
+    {
+      p_dst[2 * x] = DitherSample(p_src_u[x], d[x & 7], shift);
+      p_dst[2 * x + 1] = DitherSample(p_src_v[x], d[x & 7], shift);
+    }
+    p_dst += i_dst_pitch;
+    p_src_u += i_src_stride;
+    p_src_v += i_src_stride;
+  }
+}
+
+/*****************************************************************************
+ * SSE4.1 and AVX2 versions of the box filter downscale: the rows are summed
+ * vertically, then pairs of columns with hadd (wrapping, read as unsigned),
+ * and the averages are stored like in the copies
+ *****************************************************************************/
+template <int factor>
+VVC_TARGET_SSE4_1
+static inline __m128i BoxAverage8_SSE4_1(const short* src, int i_src_stride, __m128i round, __m128i count)
+{
+  // 8 output samples from factor * 8 columns
+  __m128i v[4];
+  for (int k = 0; k < factor; k++)
+  {
+    v[k] = _mm_loadu_si128((const __m128i*)(src + 8 * k));
+  }
+  for (int j = 1; j < factor; j++)
+  {
+    src += i_src_stride;
+    for (int k = 0; k < factor; k++)
+    {
+      v[k] = _mm_add_epi16(v[k], _mm_loadu_si128((const __m128i*)(src + 8 * k)));
+    }
+  }
+  __m128i sum = _mm_hadd_epi16(v[0], v[1]);
+  if (factor == 4)
+    sum = _mm_hadd_epi16(sum, _mm_hadd_epi16(v[2], v[3]));
+  return _mm_srl_epi16(_mm_add_epi16(sum, round), count);
+}
+
+VVC_TARGET_SSE4_1
+static void DownscaleRow_SSE4_1(uint8_t* p_dst, const short* p_src, const short* p_src_v, int i_src_stride,
+  int x, int width, int log2Factor, int sampleSize, int shift, const int16_t* thresholds)
+{
+  const int factor = 1 << log2Factor;
+  const __m128i round = _mm_set1_epi16((short)(1 << (2 * log2Factor - 1)));
+  const __m128i count = _mm_cvtsi32_si128(2 * log2Factor);
+  const __m128i shiftCount = _mm_cvtsi32_si128(shift);
+  const __m128i dither = _mm_loadu_si128((const __m128i*)thresholds);
+  const int width8 = width & ~7;
+  for (; x < width8; x += 8)
+  {
+    __m128i u = factor == 2 ? BoxAverage8_SSE4_1<2>(p_src + x * factor, i_src_stride, round, count)
+      : BoxAverage8_SSE4_1<4>(p_src + x * factor, i_src_stride, round, count);
+    u = (sampleSize == 1) ? _mm_srl_epi16(_mm_add_epi16(u, dither), shiftCount) : _mm_sll_epi16(u, shiftCount);
+    if (!p_src_v)
+    {
+      if (sampleSize == 1)
+        _mm_storel_epi64((__m128i*)(p_dst + x), _mm_packus_epi16(u, u));
+      else
+        _mm_storeu_si128((__m128i*)(p_dst + 2 * x), u);
+      continue;
+    }
+    __m128i v = factor == 2 ? BoxAverage8_SSE4_1<2>(p_src_v + x * factor, i_src_stride, round, count)
+      : BoxAverage8_SSE4_1<4>(p_src_v + x * factor, i_src_stride, round, count);
+    v = (sampleSize == 1) ? _mm_srl_epi16(_mm_add_epi16(v, dither), shiftCount) : _mm_sll_epi16(v, shiftCount);
+    const __m128i lo = _mm_unpacklo_epi16(u, v);
+    const __m128i hi = _mm_unpackhi_epi16(u, v);
+    if (sampleSize == 1)
+    {
+      _mm_storeu_si128((__m128i*)(p_dst + 2 * x), _mm_packus_epi16(lo, hi));
+    }
+    else
+    {
+      _mm_storeu_si128((__m128i*)(p_dst + 4 * x), lo);
+      _mm_storeu_si128((__m128i*)(p_dst + 4 * x + 16), hi);
+    }
+  }
+  DownscaleRow_C(p_dst, p_src, p_src_v, i_src_stride, x, width, log2Factor, sampleSize, shift, thresholds);
+}
+
+VVC_TARGET_SSE4_1
+static void DownscalePlane_SSE4_1(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, const short* p_src_v, int i_src_stride, int width, int lines,
+  int log2Factor, int sampleSize, int shift)
+{
+  if (log2Factor != 1 && log2Factor != 2)
+  {
+    DownscalePlane_C(p_dst, i_dst_pitch, p_src, p_src_v, i_src_stride, width, lines, log2Factor, sampleSize, shift);
+    return;
+  }
+  int16_t dither[8][16];
+  InitDither(dither, sampleSize == 1 ? shift : 0);
+  const int srcStep = i_src_stride << log2Factor;
+  for (int y = 0; y < lines; y++)
+  {
+    DownscaleRow_SSE4_1(p_dst, p_src, p_src_v, i_src_stride, 0, width, log2Factor, sampleSize, shift, dither[y & 7]);
+    p_dst += i_dst_pitch;
+    p_src += srcStep;
+    if (p_src_v)
+      p_src_v += srcStep;
+  }
+}
+
+template <int factor>
+VVC_TARGET_AVX2
+static inline __m256i BoxAverage16_AVX2(const short* src, int i_src_stride, __m256i round, __m128i count)
+{
+  // 16 output samples from factor * 16 columns
+  __m256i v[4];
+  for (int k = 0; k < factor; k++)
+  {
+    v[k] = _mm256_loadu_si256((const __m256i*)(src + 16 * k));
+  }
+  for (int j = 1; j < factor; j++)
+  {
+    src += i_src_stride;
+    for (int k = 0; k < factor; k++)
+    {
+      v[k] = _mm256_add_epi16(v[k], _mm256_loadu_si256((const __m256i*)(src + 16 * k)));
+    }
+  }
+  // hadd works per 128-bit lane: restore sample order across lanes
+  __m256i sum = _mm256_hadd_epi16(v[0], v[1]);
+  if (factor == 4)
+  {
+    sum = _mm256_hadd_epi16(sum, _mm256_hadd_epi16(v[2], v[3]));
+    sum = _mm256_shuffle_epi32(_mm256_permute4x64_epi64(sum, 0xD8), 0xD8);
+  }
+  else
+  {
+    sum = _mm256_permute4x64_epi64(sum, 0xD8);
+  }
+  return _mm256_srl_epi16(_mm256_add_epi16(sum, round), count);
+}
+
+VVC_TARGET_AVX2
+static void DownscalePlane_AVX2(uint8_t* p_dst, int i_dst_pitch,
+  const short* p_src, const short* p_src_v, int i_src_stride, int width, int lines,
+  int log2Factor, int sampleSize, int shift)
+{
+  if (log2Factor != 1 && log2Factor != 2)
+  {
+    DownscalePlane_C(p_dst, i_dst_pitch, p_src, p_src_v, i_src_stride, width, lines, log2Factor, sampleSize, shift);
+    return;
+  }
+  const int factor = 1 << log2Factor;
+  const __m256i round = _mm256_set1_epi16((short)(1 << (2 * log2Factor - 1)));
+  const __m128i count = _mm_cvtsi32_si128(2 * log2Factor);
+  const __m128i shiftCount = _mm_cvtsi32_si128(shift);
+  int16_t dither[8][16];
+  InitDither(dither, sampleSize == 1 ? shift : 0);
+  const int srcStep = i_src_stride << log2Factor;
+  const int width16 = width & ~15;
+  for (int y = 0; y < lines; y++)
+  {
+    const __m256i thresholds = _mm256_loadu_si256((const __m256i*)dither[y & 7]);
+    int x = 0;
+    for (; x < width16; x += 16)
+    {
+      __m256i u = factor == 2 ? BoxAverage16_AVX2<2>(p_src + x * factor, i_src_stride, round, count)
+        : BoxAverage16_AVX2<4>(p_src + x * factor, i_src_stride, round, count);
+      u = (sampleSize == 1) ? _mm256_srl_epi16(_mm256_add_epi16(u, thresholds), shiftCount) : _mm256_sll_epi16(u, shiftCount);
+      if (!p_src_v)
+      {
+        if (sampleSize == 1)
+          _mm_storeu_si128((__m128i*)(p_dst + x), _mm256_castsi256_si128(_mm256_permute4x64_epi64(_mm256_packus_epi16(u, u), 0xD8)));
+        else
+          _mm256_storeu_si256((__m256i*)(p_dst + 2 * x), u);
+        continue;
+      }
+      __m256i v = factor == 2 ? BoxAverage16_AVX2<2>(p_src_v + x * factor, i_src_stride, round, count)
+        : BoxAverage16_AVX2<4>(p_src_v + x * factor, i_src_stride, round, count);
+      v = (sampleSize == 1) ? _mm256_srl_epi16(_mm256_add_epi16(v, thresholds), shiftCount) : _mm256_sll_epi16(v, shiftCount);
+      const __m256i lo = _mm256_unpacklo_epi16(u, v);
+      const __m256i hi = _mm256_unpackhi_epi16(u, v);
+      if (sampleSize == 1)
+      {
+        _mm256_storeu_si256((__m256i*)(p_dst + 2 * x), _mm256_packus_epi16(lo, hi));
+      }
+      else
+      {
+        _mm256_storeu_si256((__m256i*)(p_dst + 4 * x), _mm256_permute2x128_si256(lo, hi, 0x20));
+        _mm256_storeu_si256((__m256i*)(p_dst + 4 * x + 32), _mm256_permute2x128_si256(lo, hi, 0x31));
+      }
+    }
+    DownscaleRow_SSE4_1(p_dst, p_src, p_src_v, i_src_stride, x, width, log2Factor, sampleSize, shift, dither[y & 7]);
+    p_dst += i_dst_pitch;
+    p_src += srcStep;
+    if (p_src_v)
+      p_src_v += srcStep;
+  }
+}
+#endif
+
+/*****************************************************************************
+ * Runtime selection
+ *****************************************************************************/
+VvcDecoder::copy_impl_e VvcDecoder::GetCopyImpl()
+{
+#ifdef VVC_COPY_X86
+  if (vlc_CPU_AVX2())
+    return COPY_IMPL_AVX2;
+  if (vlc_CPU_SSE4_1())
+    return COPY_IMPL_SSE4_1;
+#endif
+  return COPY_IMPL_C;
+}
+
+const char* VvcDecoder::GetCopyImplName(copy_impl_e impl)
+{
+  switch (impl)
+  {
+  case COPY_IMPL_AVX2:
+    return "avx2";
+  case COPY_IMPL_SSE4_1:
+    return "sse4.1";
+  case COPY_IMPL_C:
+  default:
+    return "c";
+  }
+}
+
+VvcDecoder::copy_plane_narrow_t VvcDecoder::GetCopyPlaneNarrow(copy_impl_e impl)
+{
+  switch (impl)
+  {
+#ifdef VVC_COPY_X86
+  case COPY_IMPL_AVX2:
+    return CopyPlaneNarrow_AVX2;
+  case COPY_IMPL_SSE4_1:
+    return CopyPlaneNarrow_SSE4_1;
+#endif
+  case COPY_IMPL_C:
+  default:
+    return CopyPlaneNarrow_C;
+  }
+}
+
+VvcDecoder::copy_plane_t VvcDecoder::GetCopyPlane(copy_impl_e impl)
+{
+  switch (impl)
+  {
+#ifdef VVC_COPY_X86
+  case COPY_IMPL_AVX2:
+  case COPY_IMPL_SSE4_1:
+    return CopyPlane_SSE4_1;
+#endif
+  case COPY_IMPL_C:
+  default:
+    return CopyPlane_C;
+  }
+}
+
+VvcDecoder::copy_plane_t VvcDecoder::GetCopyPlaneStream(copy_impl_e impl)
+{
+  switch (impl)
+  {
+#ifdef VVC_COPY_X86
+  case COPY_IMPL_AVX2:
+  case COPY_IMPL_SSE4_1:
+    return CopyPlaneStream_SSE4_1;
+#endif
+  case COPY_IMPL_C:
+  default:
+    return NULL;
+  }
+}
+
+VvcDecoder::copy_plane_shift_t VvcDecoder::GetCopyPlaneShift(copy_impl_e impl)
+{
+  switch (impl)
+  {
+#ifdef VVC_COPY_X86
+  case COPY_IMPL_AVX2:
+    return CopyPlaneShift_AVX2;
+  case COPY_IMPL_SSE4_1:
+    return CopyPlaneShift_SSE4_1;
+#endif
+  case COPY_IMPL_C:
+  default:
+    return CopyPlaneShift_C;
+  }
+}
+
+VvcDecoder::interleave_plane_narrow_t VvcDecoder::GetInterleavePlaneNarrow(copy_impl_e impl)
+{
+  switch (impl)
+  {
+#ifdef VVC_COPY_X86
+  case COPY_IMPL_AVX2:
+    return InterleavePlaneNarrow_AVX2;
+  case COPY_IMPL_SSE4_1:
+    return InterleavePlaneNarrow_SSE4_1;
+#endif
+  case COPY_IMPL_C:
+  default:
+    return InterleavePlaneNarrow_C;
+  }
+}
+
+VvcDecoder::interleave_plane_t VvcDecoder::GetInterleavePlane(copy_impl_e impl)
+{
+  switch (impl)
+  {
+#ifdef VVC_COPY_X86
+  case COPY_IMPL_AVX2:
+    return InterleavePlane_AVX2;
+  case COPY_IMPL_SSE4_1:
+    return InterleavePlane_SSE4_1;
+#endif
+  case COPY_IMPL_C:
+  default:
+    return InterleavePlane_C;
+  }
+}
+
+VvcDecoder::copy_plane_dither_t VvcDecoder::GetCopyPlaneDither(copy_impl_e impl)
+{
+  switch (impl)
+  {
+#ifdef VVC_COPY_X86
+  case COPY_IMPL_AVX2:
+    return CopyPlaneDither_AVX2;
+  case COPY_IMPL_SSE4_1:
+    return CopyPlaneDither_SSE4_1;
+#endif
+  case COPY_IMPL_C:
+  default:
+    return CopyPlaneDither_C;
+  }
+}
+
+VvcDecoder::interleave_plane_dither_t VvcDecoder::GetInterleavePlaneDither(copy_impl_e impl)
+{
+  switch (impl)
+  {
+#ifdef VVC_COPY_X86
+  case COPY_IMPL_AVX2:
+    return InterleavePlaneDither_AVX2;
+  case COPY_IMPL_SSE4_1:
+    return InterleavePlaneDither_SSE4_1;
+#endif
+  case COPY_IMPL_C:
+  default:
+    return InterleavePlaneDither_C;
+  }
+}
+
+VvcDecoder::downscale_plane_t VvcDecoder::GetDownscalePlane(copy_impl_e impl)
+{
+  switch (impl)
+  {
+#ifdef VVC_COPY_X86
+  case COPY_IMPL_AVX2:
+    return DownscalePlane_AVX2;
+  case COPY_IMPL_SSE4_1:
+    return DownscalePlane_SSE4_1;
+#endif
+  case COPY_IMPL_C:
+  default:
+    return DownscalePlane_C;
+  }
+}
@@ -0,0 +1,103 @@
+/*****************************************************************************
+ * vvc_picture_copy.h: copy of VTM output planes into vlc pictures
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VVC_PICTURE_COPY_H_
+#define VVC_PICTURE_COPY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace VvcDecoder
+{
+  /* Copies a plane of 16-bit VTM samples (values in [0-255]) into an 8-bit plane.
+   * width is in samples, pitches/strides in bytes for dst and in samples for src */
+  typedef void (*copy_plane_narrow_t)(uint8_t* p_dst, int i_dst_pitch,
+    const short* p_src, int i_src_stride, int width, int lines);
+
+  /* Copies a plane of 16-bit VTM samples into a 16-bit plane.
+   * width is in bytes, pitches/strides in bytes for dst and in samples for src */
+  typedef void (*copy_plane_t)(uint8_t* p_dst, int i_dst_pitch,
+    const short* p_src, int i_src_stride, int width, int lines);
+
+  /* Copies a plane of 16-bit VTM samples into a 16-bit plane, shifted left
+   * by shift bits (MSB-aligned formats like P010).
+   * width is in samples, pitches/strides in bytes for dst and in samples for src */
+  typedef void (*copy_plane_shift_t)(uint8_t* p_dst, int i_dst_pitch,
+    const short* p_src, int i_src_stride, int width, int lines, int shift);
+
+  /* Interleaves the Cb and Cr planes of 16-bit VTM samples into the chroma plane
+   * of a semi-planar picture: 8-bit (NV12) for the narrow version, 16-bit
+   * shifted left by shift bits (P010) otherwise.
+   * width is in samples of one source plane, pitches/strides in bytes for dst
+   * and in samples for src */
+  typedef void (*interleave_plane_narrow_t)(uint8_t* p_dst, int i_dst_pitch,
+    const short* p_src_u, const short* p_src_v, int i_src_stride, int width, int lines);
+  typedef void (*interleave_plane_t)(uint8_t* p_dst, int i_dst_pitch,
+    const short* p_src_u, const short* p_src_v, int i_src_stride, int width, int lines, int shift);
+
+  /* Same as the narrow copy and interleave, for samples of more than 8 bits:
+   * the shift dropped bits are replaced by an 8x8 ordered dither */
+  typedef void (*copy_plane_dither_t)(uint8_t* p_dst, int i_dst_pitch,
+    const short* p_src, int i_src_stride, int width, int lines, int shift);
+  typedef void (*interleave_plane_dither_t)(uint8_t* p_dst, int i_dst_pitch,
+    const short* p_src_u, const short* p_src_v, int i_src_stride, int width, int lines, int shift);
+
+  /* Downscales a plane of 16-bit VTM samples (up to 12 bits) by 1 << log2Factor
+   * in both directions, each output sample being the rounded average of its
+   * source block (box filter), and stores it like the copies above: 8-bit
+   * (sampleSize 1) with the dither of the shift dropped bits, shift 0 being
+   * the narrow copy, or 16-bit (sampleSize 2) shifted left by shift. With
+   * p_src_v, Cb and Cr are interleaved into a semi-planar chroma plane.
+   * width and lines are those of dst in samples of one source plane, pitches
+   * in bytes for dst and strides in samples for src */
+  typedef void (*downscale_plane_t)(uint8_t* p_dst, int i_dst_pitch,
+    const short* p_src, const short* p_src_v, int i_src_stride, int width, int lines,
+    int log2Factor, int sampleSize, int shift);
+
+  /* Above this size in bytes the destination of the 16-bit copy does not stay
+   * in cache until the vout reads it: the SIMD versions write it with
+   * non-temporal stores instead of memcpy (see vvcdec_bench --copy) */
+  static const size_t STREAM_COPY_MIN_SIZE = 1 << 20;
+
+  enum copy_impl_e
+  {
+    COPY_IMPL_C,
+    COPY_IMPL_SSE4_1,
+    COPY_IMPL_AVX2,
+  };
+
+  copy_plane_narrow_t GetCopyPlaneNarrow(copy_impl_e impl);
+  copy_plane_t GetCopyPlane(copy_impl_e impl);
+  /* 16-bit copy always using non-temporal stores whatever the size, NULL
+   * without SIMD version: for the benchmark of STREAM_COPY_MIN_SIZE */
+  copy_plane_t GetCopyPlaneStream(copy_impl_e impl);
+  copy_plane_shift_t GetCopyPlaneShift(copy_impl_e impl);
+  interleave_plane_narrow_t GetInterleavePlaneNarrow(copy_impl_e impl);
+  interleave_plane_t GetInterleavePlane(copy_impl_e impl);
+  copy_plane_dither_t GetCopyPlaneDither(copy_impl_e impl);
+  interleave_plane_dither_t GetInterleavePlaneDither(copy_impl_e impl);
+  downscale_plane_t GetDownscalePlane(copy_impl_e impl);
+  /* best implementation available on the running cpu */
+  copy_impl_e GetCopyImpl();
+  const char* GetCopyImplName(copy_impl_e impl);
+}
+
+#endif // VVC_PICTURE_COPY_H_
@@ -0,0 +1,71 @@
+/*****************************************************************************
+ * vvc_spsc_queue.h: single producer / single consumer ring buffer
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VVC_SPSC_QUEUE_H_
+#define VVC_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <stddef.h>
+
+namespace VvcDecoder
+{
+  /* Lock-free ring buffer: push() must only be called from one thread and
+   * pop() from one other thread. Capacity must be a power of 2. */
+  template<typename T, size_t Capacity>
+  class SpscQueue
+  {
+  public:
+    SpscQueue() : m_head(0), m_tail(0) {}
+
+    bool push(const T& item)
+    {
+      const size_t tail = m_tail.load(std::memory_order_relaxed);
+      if (tail - m_head.load(std::memory_order_acquire) == Capacity)
+        return false;
+      m_items[tail & (Capacity - 1)] = item;
+      m_tail.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool pop(T& item)
+    {
+      const size_t head = m_head.load(std::memory_order_relaxed);
+      if (head == m_tail.load(std::memory_order_acquire))
+        return false;
+      item = m_items[head & (Capacity - 1)];
+      m_head.store(head + 1, std::memory_order_release);
+      return true;
+    }
+
+    size_t size() const
+    {
+      return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+  private:
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of 2");
+    T m_items[Capacity];
+    std::atomic<size_t> m_head;
+    std::atomic<size_t> m_tail;
+  };
+}
+
+#endif // VVC_SPSC_QUEUE_H_
@@ -0,0 +1,108 @@
+/*****************************************************************************
+ * vvc_stats.h: fixed-size histograms for decoder statistics
+ *****************************************************************************
+ * Copyright (C) 2021 interdigital
+ *
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2.1 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston MA 02110-1301, USA.
+ *****************************************************************************/
+
+#ifndef VVC_STATS_H_
+#define VVC_STATS_H_
+
+#include <stdint.h>
+#include <string.h>
+
+namespace VvcDecoder
+{
+  /* Log-scale histogram of non-negative values: 4 buckets per power of 2,
+   * i.e. percentiles are accurate to ~20%. No allocation, O(1) insertion. */
+  class Histogram
+  {
+  public:
+    Histogram() { reset(); }
+
+    void reset()
+    {
+      memset(m_buckets, 0, sizeof(m_buckets));
+      m_count = 0;
+      m_sum = 0;
+      m_max = 0;
+    }
+
+    void add(int64_t value)
+    {
+      if (value < 0)
+        value = 0;
+      m_buckets[bucketIndex((uint64_t)value)]++;
+      m_count++;
+      m_sum += value;
+      if (value > m_max)
+        m_max = value;
+    }
+
+    uint64_t count() const { return m_count; }
+    int64_t max() const { return m_max; }
+    int64_t mean() const { return m_count ? m_sum / (int64_t)m_count : 0; }
+
+    /* upper bound of the bucket holding the given percentile [0-100] */
+    int64_t percentile(unsigned int pct) const
+    {
+      if (!m_count)
+        return 0;
+      const uint64_t rank = (m_count * pct + 99) / 100;
+      uint64_t acc = 0;
+      for (int i = 0; i < NB_BUCKETS; i++)
+      {
+        acc += m_buckets[i];
+        if (acc >= rank && acc > 0)
+        {
+          const int64_t bound = bucketUpperBound(i);
+          return bound < m_max ? bound : m_max;
+        }
+      }
+      return m_max;
+    }
+
+  private:
+    static const int NB_BUCKETS = 4 * 63;
+
+    static int bucketIndex(uint64_t v)
+    {
+      if (v < 4)
+        return (int)v;
+      int msb = 63;
+      while (!(v >> msb))
+        msb--;
+      return 4 * (msb - 1) + (int)((v >> (msb - 2)) & 3);
+    }
+
+    static int64_t bucketUpperBound(int idx)
+    {
+      if (idx < 4)
+        return idx;
+      const int msb = idx / 4 + 1;
+      const int64_t sub = idx & 3;
+      return ((4 + sub + 1) << (msb - 2)) - 1;
+    }
+
+    uint32_t m_buckets[NB_BUCKETS];
+    uint64_t m_count;
+    int64_t  m_sum;
+    int64_t  m_max;
+  };
+}
+
+#endif // VVC_STATS_H_